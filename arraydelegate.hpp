@@ -6,421 +6,262 @@
 
 #include <cstddef>
 
+#include <cstring>
+
 #include <new>
 
 #include <type_traits>
 
 #include <utility>
 
+#include "basicdelegate.hpp"
+
 namespace generic
 {
 
-template <typename T> class arraydelegate;
-
-template<class R, class ...A>
-class arraydelegate<R (A...)>
+// functors are stored inside the delegate; if S is set, functors, that do not
+// fit into N bytes aligned to A, spill to the heap, otherwise they fail to
+// compile; A defaults to pointer alignment, so that small stores are not
+// padded
+template <::std::size_t N, bool S = false, ::std::size_t A = alignof(void*)>
+class array_store
 {
-  static constexpr auto max_store_size = 10 * sizeof(::std::size_t);
+  static_assert(N >= sizeof(void*), "N has to fit a pointer");
+  static_assert(A >= alignof(void*), "A has to align a pointer");
 
-  using stub_ptr_type = R (*)(void*, A&&...);
+  // moves must not throw, other functors spill
+  template <typename T>
+  using is_inline = ::std::integral_constant<bool,
+    (sizeof(T) <= N) && (alignof(T) <= A) &&
+    ::std::is_nothrow_move_constructible<T>{}
+  >;
 
-  arraydelegate(void* const o, stub_ptr_type const m) noexcept :
-    object_ptr_(o),
-    stub_ptr_(m)
+  // one static table per stored type; a nullptr copy or move copies the
+  // buffer bytes, a nullptr destroy does nothing
+  struct ops_type
   {
-  }
+    void (*destroy)(array_store&);
 
-public:
-  arraydelegate() = default;
+    void (*copy)(array_store&, array_store const&);
+    void (*move)(array_store&, array_store&);
 
-  arraydelegate(arraydelegate const& other) { *this = other; }
+    // the buffer holds a pointer to the object, not the object itself
+    bool indirect;
+  };
 
-  arraydelegate(arraydelegate&& other) { *this = ::std::move(other); }
+public:
+  static constexpr auto const max_store_size = N;
 
-  arraydelegate(::std::nullptr_t const) noexcept : arraydelegate() { }
+  array_store() noexcept { new (static_cast<void*>(store_)) void*{}; }
 
-  template <class C, typename =
-    typename ::std::enable_if< ::std::is_class<C>{}>::type>
-  explicit arraydelegate(C const* const o) noexcept :
-    object_ptr_(const_cast<C*>(o))
-  {
-  }
+  array_store(array_store const& other) { copy(other); }
 
-  template <class C, typename =
-    typename ::std::enable_if< ::std::is_class<C>{}>::type>
-  explicit arraydelegate(C const& o) noexcept :
-    object_ptr_(const_cast<C*>(&o))
-  {
-  }
+  array_store(array_store&& other) noexcept { move(other); }
 
-  template <class C>
-  arraydelegate(C* const object_ptr, R (C::* const method_ptr)(A...))
-  {
-    *this = from(object_ptr, method_ptr);
-  }
+  ~array_store() { reset(); }
 
-  template <class C>
-  arraydelegate(C* const object_ptr, R (C::* const method_ptr)(A...) const)
+  array_store& operator=(array_store const& rhs)
   {
-    *this = from(object_ptr, method_ptr);
-  }
+    if (this != &rhs)
+    {
+      reset();
 
-  template <class C>
-  arraydelegate(C& object, R (C::* const method_ptr)(A...))
-  {
-    *this = from(object, method_ptr);
-  }
+      copy(rhs);
+    }
+    // else do nothing
 
-  template <class C>
-  arraydelegate(C const& object, R (C::* const method_ptr)(A...) const)
-  {
-    *this = from(object, method_ptr);
+    return *this;
   }
 
-  template <
-    typename T,
-    typename = typename ::std::enable_if<
-      !::std::is_same<arraydelegate, typename ::std::decay<T>::type>{}
-    >::type
-  >
-  arraydelegate(T&& f)
+  array_store& operator=(array_store&& rhs) noexcept
   {
-    using functor_type = typename ::std::decay<T>::type;
-
-    static_assert(sizeof(functor_type) <= sizeof(store_),
-      "increase store_ size");
-    new (store_) functor_type(::std::forward<T>(f));
-
-    object_ptr_ = store_;
-    stub_ptr_ = functor_stub<functor_type>;
-
-    deleter_ = deleter_stub<functor_type>;
-
-    copier_ = copier_stub<functor_type>;
-    mover_ = mover_stub<functor_type>;
-  }
-
-  ~arraydelegate() { deleter_(this); }
+    if (this != &rhs)
+    {
+      reset();
 
-  arraydelegate& operator=(arraydelegate const& rhs)
-  {
-    rhs.copier_(*this, const_cast<arraydelegate&>(rhs));
+      move(rhs);
+    }
+    // else do nothing
 
     return *this;
   }
 
-  arraydelegate& operator=(arraydelegate&& rhs)
+  template <typename T, typename F>
+  void emplace(F&& f)
   {
-    rhs.mover_(*this, rhs);
+    static_assert(S || is_inline<T>{},
+      "increase store_ size or make the functor nothrow movable");
 
-    return *this;
-  }
+    reset();
 
-  template <class C>
-  arraydelegate& operator=(R (C::* const rhs)(A...))
-  {
-    return *this = from(static_cast<C*>(object_ptr_), rhs);
+    construct<T>(::std::forward<F>(f), is_inline<T>{});
   }
 
-  template <class C>
-  arraydelegate& operator=(R (C::* const rhs)(A...) const)
+  void* object() const noexcept
   {
-    return *this = from(static_cast<C const*>(object_ptr_), rhs);
+    return ops_->indirect ?
+      pointer() :
+      const_cast<void*>(static_cast<void const*>(store_));
   }
 
-  template <
-    typename T,
-    typename = typename ::std::enable_if<
-      !::std::is_same<arraydelegate, typename ::std::decay<T>::type>{}
-    >::type
-  >
-  arraydelegate& operator=(T&& f)
+  void reset(void* const o = nullptr) noexcept
   {
-    using functor_type = typename ::std::decay<T>::type;
-
-    deleter_(store_);
-
-    static_assert(sizeof(functor_type) <= sizeof(store_),
-      "increase store_ size");
-    new (store_) functor_type(::std::forward<T>(f));
-
-    object_ptr_ = store_;
-    stub_ptr_ = functor_stub<functor_type>;
-
-    deleter_ = deleter_stub<functor_type>;
+    if (ops_->destroy)
+    {
+      ops_->destroy(*this);
+    }
+    // else do nothing
 
-    copier_ = copier_stub<functor_type>;
-    mover_ = mover_stub<functor_type>;
+    new (static_cast<void*>(store_)) void*(o);
 
-    return *this;
+    ops_ = indirect_ops();
   }
 
-  template <R (* const function_ptr)(A...)>
-  static arraydelegate from() noexcept
-  {
-    return { nullptr, function_stub<function_ptr> };
-  }
-
-  template <class C, R (C::* const method_ptr)(A...)>
-  static arraydelegate from(C* const object_ptr) noexcept
-  {
-    return { object_ptr, method_stub<C, method_ptr> };
-  }
+private:
+  alignas(A) char store_[N];
 
-  template <class C, R (C::* const method_ptr)(A...) const>
-  static arraydelegate from(C const* const object_ptr) noexcept
-  {
-    return { const_cast<C*>(object_ptr), const_method_stub<C, method_ptr> };
-  }
+  ops_type const* ops_{indirect_ops()};
 
-  template <class C, R (C::* const method_ptr)(A...)>
-  static arraydelegate from(C& object) noexcept
+  void* pointer() const noexcept
   {
-    return { &object, method_stub<C, method_ptr> };
+    return *reinterpret_cast<void* const*>(store_);
   }
 
-  template <class C, R (C::* const method_ptr)(A...) const>
-  static arraydelegate from(C const& object) noexcept
+  void copy(array_store const& other)
   {
-    return { const_cast<C*>(&object), const_method_stub<C, method_ptr> };
-  }
+    if (other.ops_->copy)
+    {
+      other.ops_->copy(*this, other);
+    }
+    else
+    {
+      ::std::memcpy(store_, other.store_, N);
+    }
 
-  template <typename T>
-  static arraydelegate from(T&& f)
-  {
-    return ::std::forward<T>(f);
+    ops_ = other.ops_;
   }
 
-  static arraydelegate from(R (* const function_ptr)(A...))
+  void move(array_store& other) noexcept
   {
-    return function_ptr;
-  }
-
-  template <class C>
-  using member_pair =
-    ::std::pair<C* const, R (C::* const)(A...)>;
+    auto const ops(other.ops_);
 
-  template <class C>
-  using const_member_pair =
-    ::std::pair<C const* const, R (C::* const)(A...) const>;
+    if (ops->move)
+    {
+      ops->move(*this, other);
+    }
+    else
+    {
+      ::std::memcpy(store_, other.store_, N);
+    }
 
-  template <class C>
-  static arraydelegate from(C* const object_ptr,
-    R (C::* const method_ptr)(A...)) noexcept
-  {
-    return member_pair<C>(object_ptr, method_ptr);
+    ops_ = ops;
   }
 
-  template <class C>
-  static arraydelegate from(C const* const object_ptr,
-    R (C::* const method_ptr)(A...) const) noexcept
+  template <typename T, typename F>
+  void construct(F&& f, ::std::true_type)
   {
-    return const_member_pair<C>(object_ptr, method_ptr);
-  }
+    new (static_cast<void*>(store_)) T(::std::forward<F>(f));
 
-  template <class C>
-  static arraydelegate from(C& object,
-    R (C::* const method_ptr)(A...)) noexcept
-  {
-    return member_pair<C>(&object, method_ptr);
+    ops_ = ::std::is_trivially_copyable<T>{} ?
+      trivial_ops() :
+      inline_ops<T>();
   }
 
-  template <class C>
-  static arraydelegate from(C const& object,
-    R (C::* const method_ptr)(A...) const) noexcept
+  template <typename T, typename F>
+  void construct(F&& f, ::std::false_type)
   {
-    return const_member_pair<C>(&object, method_ptr);
-  }
-
-  void reset() noexcept { stub_ptr_ = nullptr; }
+    new (static_cast<void*>(store_)) void*(new T(::std::forward<F>(f)));
 
-  void reset_stub() noexcept { stub_ptr_ = nullptr; }
-
-  void swap(arraydelegate& other) noexcept { ::std::swap(*this, other); }
-
-  bool operator==(arraydelegate const& rhs) const noexcept
-  {
-    return (object_ptr_ == rhs.object_ptr_) && (stub_ptr_ == rhs.stub_ptr_);
+    ops_ = heap_ops<T>();
   }
 
-  bool operator!=(arraydelegate const& rhs) const noexcept
+  static ops_type const* indirect_ops() noexcept
   {
-    return !operator==(rhs);
-  }
+    static constexpr ops_type const ops{nullptr, nullptr, nullptr, true};
 
-  bool operator<(arraydelegate const& rhs) const noexcept
-  {
-    return (object_ptr_ < rhs.object_ptr_) ||
-      ((object_ptr_ == rhs.object_ptr_) && (stub_ptr_ < rhs.stub_ptr_));
+    return &ops;
   }
 
-  bool operator==(::std::nullptr_t const) const noexcept
+  static ops_type const* trivial_ops() noexcept
   {
-    return !stub_ptr_;
-  }
+    static constexpr ops_type const ops{nullptr, nullptr, nullptr, false};
 
-  bool operator!=(::std::nullptr_t const) const noexcept
-  {
-    return stub_ptr_;
+    return &ops;
   }
 
-  explicit operator bool() const noexcept { return stub_ptr_; }
-
-  R operator()(A... args) const
+  template <typename T>
+  static ops_type const* inline_ops() noexcept
   {
-//  assert(stub_ptr);
-    return stub_ptr_(object_ptr_, ::std::forward<A>(args)...);
-  }
+    static constexpr ops_type const ops{
+      destroy_stub<T>, copy_stub<T>, move_stub<T>, false
+    };
 
-private:
-  static void default_deleter_stub(void* const) { }
-
-  template <class T>
-  static void deleter_stub(void* const p)
-  {
-    static_cast<T*>(p)->~T();
+    return &ops;
   }
 
-  static void default_copier_stub(arraydelegate& dst,
-    arraydelegate& src) noexcept
+  template <typename T>
+  static ops_type const* heap_ops() noexcept
   {
-    dst.object_ptr_ = src.object_ptr_;
-    dst.stub_ptr_ = src.stub_ptr_;
+    static constexpr ops_type const ops{
+      heap_destroy_stub<T>, heap_copy_stub<T>, heap_move_stub, true
+    };
 
-    dst.deleter_ = default_deleter_stub;
-
-    dst.copier_ = default_copier_stub;
-    dst.mover_ = default_copier_stub;
+    return &ops;
   }
 
   template <typename T>
-  static void copier_stub(arraydelegate& dst,
-    arraydelegate& src)
+  static void destroy_stub(array_store& s)
   {
-    new (dst.store_) T(*static_cast<T const*>(
-      static_cast<void const*>(src.store_)));
-
-    dst.stub_ptr_ = src.stub_ptr_;
-    dst.object_ptr_ = dst.store_;
-
-    dst.deleter_ = src.deleter_;
-
-    dst.copier_ = src.copier_;
-    dst.mover_ = src.mover_;
+    static_cast<T*>(static_cast<void*>(s.store_))->~T();
   }
 
   template <typename T>
-  static void mover_stub(arraydelegate& dst,
-    arraydelegate& src)
+  static void copy_stub(array_store& dst, array_store const& src)
   {
-    new (dst.store_) T(::std::move(*static_cast<T*>(
-      static_cast<void*>(src.store_))));
-
-    dst.stub_ptr_ = src.stub_ptr_;
-    dst.object_ptr_ = dst.store_;
-
-    dst.deleter_ = src.deleter_;
-
-    dst.copier_ = src.copier_;
-    dst.mover_ = src.mover_;
+    new (static_cast<void*>(dst.store_)) T(
+      *static_cast<T const*>(static_cast<void const*>(src.store_)));
   }
 
-private:
-  friend struct ::std::hash<arraydelegate>;
-
-  using deleter_type = void (*)(void*);
-
-  using copier_type = void (*)(arraydelegate&, arraydelegate&);
-  using mover_type = void (*)(arraydelegate&, arraydelegate&);
-
-  void* object_ptr_;
-  stub_ptr_type stub_ptr_{};
-
-  deleter_type deleter_{default_deleter_stub};
-
-  copier_type copier_{default_copier_stub};
-  mover_type mover_{default_copier_stub};
-
-  alignas(::max_align_t) char store_[max_store_size];
-
-  template <R (*function_ptr)(A...)>
-  static R function_stub(void* const, A&&... args)
+  template <typename T>
+  static void move_stub(array_store& dst, array_store& src)
   {
-    return function_ptr(::std::forward<A>(args)...);
+    new (static_cast<void*>(dst.store_)) T(
+      ::std::move(*static_cast<T*>(static_cast<void*>(src.store_))));
   }
 
-  template <class C, R (C::*method_ptr)(A...)>
-  static R method_stub(void* const object_ptr, A&&... args)
+  template <typename T>
+  static void heap_destroy_stub(array_store& s)
   {
-    return (static_cast<C*>(object_ptr)->*method_ptr)(
-      ::std::forward<A>(args)...);
+    delete static_cast<T*>(s.pointer());
   }
 
-  template <class C, R (C::*method_ptr)(A...) const>
-  static R const_method_stub(void* const object_ptr, A&&... args)
+  template <typename T>
+  static void heap_copy_stub(array_store& dst, array_store const& src)
   {
-    return (static_cast<C const*>(object_ptr)->*method_ptr)(
-      ::std::forward<A>(args)...);
+    new (static_cast<void*>(dst.store_)) void*(
+      new T(*static_cast<T const*>(src.pointer())));
   }
 
-  template <typename>
-  struct is_member_pair : std::false_type { };
-
-  template <class C>
-  struct is_member_pair< ::std::pair<C* const,
-    R (C::* const)(A...)> > : std::true_type
-  {
-  };
-
-  template <typename>
-  struct is_const_member_pair : std::false_type { };
-
-  template <class C>
-  struct is_const_member_pair< ::std::pair<C const* const,
-    R (C::* const)(A...) const> > : std::true_type
+  static void heap_move_stub(array_store& dst, array_store& src)
   {
-  };
+    new (static_cast<void*>(dst.store_)) void*(src.pointer());
 
-  template <typename T>
-  static typename ::std::enable_if<
-    !(is_member_pair<T>{} ||
-    is_const_member_pair<T>{}),
-    R
-  >::type
-  functor_stub(void* const object_ptr, A&&... args)
-  {
-    return (*static_cast<T*>(object_ptr))(::std::forward<A>(args)...);
-  }
+    // the heap object changed owners, src is left empty
+    new (static_cast<void*>(src.store_)) void*{};
 
-  template <typename T>
-  static typename ::std::enable_if<
-    is_member_pair<T>{} ||
-    is_const_member_pair<T>{},
-    R
-  >::type
-  functor_stub(void* const object_ptr, A&&... args)
-  {
-    return (static_cast<T*>(object_ptr)->first->*
-      static_cast<T*>(object_ptr)->second)(::std::forward<A>(args)...);
+    src.ops_ = indirect_ops();
   }
 };
 
-}
+template <::std::size_t N, ::std::size_t A = alignof(void*)>
+using spill_store = array_store<N, true, A>;
 
-namespace std
-{
-  template <typename R, typename ...A>
-  struct hash<::generic::arraydelegate<R (A...)> >
-  {
-    size_t operator()(
-      ::generic::arraydelegate<R (A...)> const& d) const noexcept
-    {
-      auto const seed(hash<void*>()(d.object_ptr_));
+// N is the inline capacity in bytes, S enables the heap spill, A is the
+// alignment of the inline store
+template <typename T, ::std::size_t N = 10 * sizeof(::std::size_t),
+  bool S = false, ::std::size_t A = alignof(void*)>
+using arraydelegate = basic_delegate<T, array_store<N, S, A> >;
 
-      return hash<decltype(d.stub_ptr_)>()(d.stub_ptr_) +
-        0x9e3779b9 + (seed << 6) + (seed >> 2);
-    }
-  };
 }
 
 #endif // ARRAYDELEGATE_HPP
@@ -0,0 +1,113 @@
+#ifndef ATOMICDELEGATE_HPP
+# define ATOMICDELEGATE_HPP
+# pragma once
+
+#include <cassert>
+
+#include <atomic>
+
+#include <utility>
+
+#include "delegate.hpp"
+
+#include "epoch.hpp"
+
+namespace generic
+{
+
+template <typename T> class atomic_delegate;
+
+template <class R, class ...A>
+class atomic_delegate<R (A...)>
+{
+public:
+  using delegate_type = delegate<R (A...)>;
+
+  atomic_delegate() = default;
+
+  explicit atomic_delegate(delegate_type d) :
+    delegate_(d ? new delegate_type(::std::move(d)) : nullptr)
+  {
+  }
+
+  ~atomic_delegate()
+  {
+    delete delegate_.load(::std::memory_order_relaxed);
+  }
+
+  atomic_delegate(atomic_delegate const&) = delete;
+
+  atomic_delegate& operator=(atomic_delegate const&) = delete;
+
+  atomic_delegate& operator=(delegate_type d)
+  {
+    store(::std::move(d));
+
+    return *this;
+  }
+
+  void store(delegate_type d)
+  {
+    retire(delegate_.exchange(d ? new delegate_type(::std::move(d)) :
+      nullptr));
+  }
+
+  delegate_type exchange(delegate_type d)
+  {
+    auto const p(delegate_.exchange(d ?
+      new delegate_type(::std::move(d)) : nullptr));
+
+    delegate_type r(p ? *p : delegate_type());
+
+    retire(p);
+
+    return r;
+  }
+
+  delegate_type load() const
+  {
+    typename detail::epoch<>::guard const g;
+
+    auto const p(delegate_.load(::std::memory_order_acquire));
+
+    return p ? *p : delegate_type();
+  }
+
+  void reset() { store(nullptr); }
+
+  explicit operator bool() const noexcept
+  {
+    return delegate_.load(::std::memory_order_relaxed);
+  }
+
+  R operator()(A... args) const
+  {
+    typename detail::epoch<>::guard const g;
+
+    auto const p(delegate_.load(::std::memory_order_acquire));
+    assert(p);
+
+    return (*p)(::std::forward<A>(args)...);
+  }
+
+private:
+  ::std::atomic<delegate_type*> delegate_{};
+
+  static void deleter(void* const p)
+  {
+    delete static_cast<delegate_type*>(p);
+  }
+
+  static void retire(delegate_type* const p)
+  {
+    if (p)
+    {
+      detail::epoch<>::retire(p, deleter);
+    }
+    // else do nothing
+  }
+};
+
+}
+
+#endif // ATOMICDELEGATE_HPP
@@ -0,0 +1,146 @@
+#ifndef ATOMICLIGHTPTR_HPP
+# define ATOMICLIGHTPTR_HPP
+# pragma once
+
+#include <cassert>
+
+#include <atomic>
+
+#include <utility>
+
+#include "epoch.hpp"
+
+#include "lightptr.hpp"
+
+namespace generic
+{
+
+// the current value lives in a heap allocated light_ptr, that is swapped
+// atomically; replaced values are retired to the epoch reclaimer, so loads
+// only pin the epoch and copy, they never wait
+template <typename T>
+class atomic_light_ptr
+{
+public:
+  using value_type = light_ptr<T>;
+
+  atomic_light_ptr() = default;
+
+  explicit atomic_light_ptr(value_type p) :
+    ptr_(p ? new value_type(::std::move(p)) : nullptr)
+  {
+  }
+
+  ~atomic_light_ptr()
+  {
+    delete ptr_.load(::std::memory_order_relaxed);
+  }
+
+  atomic_light_ptr(atomic_light_ptr const&) = delete;
+
+  atomic_light_ptr& operator=(atomic_light_ptr const&) = delete;
+
+  atomic_light_ptr& operator=(value_type p)
+  {
+    store(::std::move(p));
+
+    return *this;
+  }
+
+  operator value_type() const { return load(); }
+
+  value_type load() const
+  {
+    typename detail::epoch<>::guard const g;
+
+    auto const p(ptr_.load(::std::memory_order_acquire));
+
+    return p ? *p : value_type();
+  }
+
+  void store(value_type p)
+  {
+    // seq_cst, the epoch scan has to see readers, that pinned before the
+    // swap
+    retire(ptr_.exchange(p ? new value_type(::std::move(p)) : nullptr));
+  }
+
+  value_type exchange(value_type p)
+  {
+    auto const old(ptr_.exchange(p ? new value_type(::std::move(p)) :
+      nullptr));
+
+    // pinned readers may still be copying *old
+    value_type r(old ? *old : value_type());
+
+    retire(old);
+
+    return r;
+  }
+
+  // values compare equal, if they share the counter; on failure, expected
+  // receives the current value
+  bool compare_exchange_strong(value_type& expected, value_type desired)
+  {
+    auto const n(desired ? new value_type(::std::move(desired)) : nullptr);
+
+    value_type* p;
+
+    {
+      typename detail::epoch<>::guard const g;
+
+      p = ptr_.load(::std::memory_order_acquire);
+
+      for (;;)
+      {
+        if (p ? *p != expected : bool(expected))
+        {
+          expected = p ? *p : value_type();
+
+          delete n;
+
+          return false;
+        }
+        else if (ptr_.compare_exchange_weak(p, n,
+          ::std::memory_order_seq_cst, ::std::memory_order_acquire))
+        {
+          break;
+        }
+        // else do nothing
+      }
+    }
+
+    // unpinned, so that the reclaimer may free p right away
+    retire(p);
+
+    return true;
+  }
+
+  bool compare_exchange_weak(value_type& expected, value_type desired)
+  {
+    return compare_exchange_strong(expected, ::std::move(desired));
+  }
+
+  bool is_lock_free() const noexcept { return ptr_.is_lock_free(); }
+
+private:
+  ::std::atomic<value_type*> ptr_{};
+
+  static void deleter(void* const p)
+  {
+    delete static_cast<value_type*>(p);
+  }
+
+  static void retire(value_type* const p)
+  {
+    if (p)
+    {
+      detail::epoch<>::retire(p, deleter);
+    }
+    // else do nothing
+  }
+};
+
+}
+
+#endif // ATOMICLIGHTPTR_HPP
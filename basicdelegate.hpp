@@ -0,0 +1,391 @@
+#ifndef BASICDELEGATE_HPP
+# define BASICDELEGATE_HPP
+# pragma once
+
+#include <cassert>
+
+#include <cstddef>
+
+#include <functional>
+
+#include <new>
+
+#include <type_traits>
+
+#include <utility>
+
+#include "meta.hpp"
+
+namespace generic
+{
+
+// S is the storage policy, it holds the object pointer passed to the stubs
+// and decides where stored functors live:
+//
+//   void emplace<T>(f)  destroys the current functor, constructs a T from f
+//   void* object()      returns the current functor or the referenced object
+//   void reset(o)       destroys the current functor, references object o
+//
+// copying or moving S copies or moves the functor it holds; a moved from
+// delegate is empty.
+template <typename F, class S> class basic_delegate;
+
+template <typename D> class batch_dispatcher;
+
+template <class R, class ...A, class S>
+class basic_delegate<R (A...), S>
+{
+  using stub_ptr_type = R (*)(void*, typename param_type<A>::type...);
+
+  basic_delegate(void* const o, stub_ptr_type const m) noexcept :
+    stub_ptr_(m)
+  {
+    store_.reset(o);
+  }
+
+public:
+  using store_type = S;
+
+  basic_delegate() = default;
+
+  basic_delegate(basic_delegate const&) = default;
+
+  basic_delegate(basic_delegate&& other)
+    noexcept(::std::is_nothrow_move_constructible<S>{}) :
+    stub_ptr_(other.stub_ptr_),
+    store_(::std::move(other.store_))
+  {
+    other.stub_ptr_ = nullptr;
+  }
+
+  basic_delegate(::std::nullptr_t const) noexcept : basic_delegate() { }
+
+  template <class C, typename =
+    typename ::std::enable_if< ::std::is_class<C>{}>::type>
+  explicit basic_delegate(C const* const o) noexcept
+  {
+    store_.reset(const_cast<C*>(o));
+  }
+
+  template <class C, typename =
+    typename ::std::enable_if< ::std::is_class<C>{}>::type>
+  explicit basic_delegate(C const& o) noexcept
+  {
+    store_.reset(const_cast<C*>(&o));
+  }
+
+  template <class C>
+  basic_delegate(C* const object_ptr, R (C::* const method_ptr)(A...))
+  {
+    *this = from(object_ptr, method_ptr);
+  }
+
+  template <class C>
+  basic_delegate(C* const object_ptr, R (C::* const method_ptr)(A...) const)
+  {
+    *this = from(object_ptr, method_ptr);
+  }
+
+  template <class C>
+  basic_delegate(C& object, R (C::* const method_ptr)(A...))
+  {
+    *this = from(object, method_ptr);
+  }
+
+  template <class C>
+  basic_delegate(C const& object, R (C::* const method_ptr)(A...) const)
+  {
+    *this = from(object, method_ptr);
+  }
+
+  template <
+    typename T,
+    typename = typename ::std::enable_if<
+      !::std::is_same<basic_delegate, typename ::std::decay<T>::type>{}
+    >::type
+  >
+  basic_delegate(T&& f)
+  {
+    using functor_type = typename ::std::decay<T>::type;
+
+    store_.template emplace<functor_type>(::std::forward<T>(f));
+
+    stub_ptr_ = functor_stub<functor_type>;
+  }
+
+  // a throwing copy leaves the delegate empty
+  basic_delegate& operator=(basic_delegate const& rhs)
+  {
+    if (this != &rhs)
+    {
+      stub_ptr_ = nullptr;
+
+      store_ = rhs.store_;
+
+      stub_ptr_ = rhs.stub_ptr_;
+    }
+    // else do nothing
+
+    return *this;
+  }
+
+  basic_delegate& operator=(basic_delegate&& rhs)
+    noexcept(::std::is_nothrow_move_assignable<S>{})
+  {
+    if (this != &rhs)
+    {
+      store_ = ::std::move(rhs.store_);
+
+      stub_ptr_ = rhs.stub_ptr_;
+      rhs.stub_ptr_ = nullptr;
+    }
+    // else do nothing
+
+    return *this;
+  }
+
+  template <class C>
+  basic_delegate& operator=(R (C::* const rhs)(A...))
+  {
+    return *this = from(static_cast<C*>(store_.object()), rhs);
+  }
+
+  template <class C>
+  basic_delegate& operator=(R (C::* const rhs)(A...) const)
+  {
+    return *this = from(static_cast<C const*>(store_.object()), rhs);
+  }
+
+  template <
+    typename T,
+    typename = typename ::std::enable_if<
+      !::std::is_same<basic_delegate, typename ::std::decay<T>::type>{}
+    >::type
+  >
+  basic_delegate& operator=(T&& f)
+  {
+    using functor_type = typename ::std::decay<T>::type;
+
+    // a throwing construction leaves the delegate empty
+    stub_ptr_ = nullptr;
+
+    store_.template emplace<functor_type>(::std::forward<T>(f));
+
+    stub_ptr_ = functor_stub<functor_type>;
+
+    return *this;
+  }
+
+  template <R (* const function_ptr)(A...)>
+  static basic_delegate from() noexcept
+  {
+    return { nullptr, function_stub<function_ptr> };
+  }
+
+  template <class C, R (C::* const method_ptr)(A...)>
+  static basic_delegate from(C* const object_ptr) noexcept
+  {
+    return { object_ptr, method_stub<C, method_ptr> };
+  }
+
+  template <class C, R (C::* const method_ptr)(A...) const>
+  static basic_delegate from(C const* const object_ptr) noexcept
+  {
+    return { const_cast<C*>(object_ptr), const_method_stub<C, method_ptr> };
+  }
+
+  template <class C, R (C::* const method_ptr)(A...)>
+  static basic_delegate from(C& object) noexcept
+  {
+    return { &object, method_stub<C, method_ptr> };
+  }
+
+  template <class C, R (C::* const method_ptr)(A...) const>
+  static basic_delegate from(C const& object) noexcept
+  {
+    return { const_cast<C*>(&object), const_method_stub<C, method_ptr> };
+  }
+
+  template <typename T>
+  static basic_delegate from(T&& f)
+  {
+    return ::std::forward<T>(f);
+  }
+
+  static basic_delegate from(R (* const function_ptr)(A...))
+  {
+    return function_ptr;
+  }
+
+  template <class C>
+  using member_pair =
+    ::std::pair<C* const, R (C::* const)(A...)>;
+
+  template <class C>
+  using const_member_pair =
+    ::std::pair<C const* const, R (C::* const)(A...) const>;
+
+  template <class C>
+  static basic_delegate from(C* const object_ptr,
+    R (C::* const method_ptr)(A...))
+  {
+    return member_pair<C>(object_ptr, method_ptr);
+  }
+
+  template <class C>
+  static basic_delegate from(C const* const object_ptr,
+    R (C::* const method_ptr)(A...) const)
+  {
+    return const_member_pair<C>(object_ptr, method_ptr);
+  }
+
+  template <class C>
+  static basic_delegate from(C& object, R (C::* const method_ptr)(A...))
+  {
+    return member_pair<C>(&object, method_ptr);
+  }
+
+  template <class C>
+  static basic_delegate from(C const& object,
+    R (C::* const method_ptr)(A...) const)
+  {
+    return const_member_pair<C>(&object, method_ptr);
+  }
+
+  void reset() { stub_ptr_ = nullptr; store_.reset(); }
+
+  void reset_stub() noexcept { stub_ptr_ = nullptr; }
+
+  void swap(basic_delegate& other) noexcept { ::std::swap(*this, other); }
+
+  bool operator==(basic_delegate const& rhs) const noexcept
+  {
+    return (store_.object() == rhs.store_.object()) &&
+      (stub_ptr_ == rhs.stub_ptr_);
+  }
+
+  bool operator!=(basic_delegate const& rhs) const noexcept
+  {
+    return !operator==(rhs);
+  }
+
+  bool operator<(basic_delegate const& rhs) const noexcept
+  {
+    return (store_.object() < rhs.store_.object()) ||
+      ((store_.object() == rhs.store_.object()) &&
+      (stub_ptr_ < rhs.stub_ptr_));
+  }
+
+  bool operator==(::std::nullptr_t const) const noexcept
+  {
+    return !stub_ptr_;
+  }
+
+  bool operator!=(::std::nullptr_t const) const noexcept
+  {
+    return stub_ptr_;
+  }
+
+  explicit operator bool() const noexcept { return stub_ptr_; }
+
+  R operator()(A... args) const
+  {
+//  assert(stub_ptr);
+    return stub_ptr_(store_.object(), ::std::forward<A>(args)...);
+  }
+
+private:
+  friend struct ::std::hash<basic_delegate>;
+
+  friend class batch_dispatcher<basic_delegate>;
+
+  stub_ptr_type stub_ptr_{};
+
+  S store_;
+
+  template <R (*function_ptr)(A...)>
+  static R function_stub(void* const,
+    typename param_type<A>::type... args)
+  {
+    return function_ptr(::std::forward<A>(args)...);
+  }
+
+  template <class C, R (C::*method_ptr)(A...)>
+  static R method_stub(void* const object_ptr,
+    typename param_type<A>::type... args)
+  {
+    return (static_cast<C*>(object_ptr)->*method_ptr)(
+      ::std::forward<A>(args)...);
+  }
+
+  template <class C, R (C::*method_ptr)(A...) const>
+  static R const_method_stub(void* const object_ptr,
+    typename param_type<A>::type... args)
+  {
+    return (static_cast<C const*>(object_ptr)->*method_ptr)(
+      ::std::forward<A>(args)...);
+  }
+
+  template <typename>
+  struct is_member_pair : std::false_type { };
+
+  template <class C>
+  struct is_member_pair< ::std::pair<C* const,
+    R (C::* const)(A...)> > : std::true_type
+  {
+  };
+
+  template <typename>
+  struct is_const_member_pair : std::false_type { };
+
+  template <class C>
+  struct is_const_member_pair< ::std::pair<C const* const,
+    R (C::* const)(A...) const> > : std::true_type
+  {
+  };
+
+  template <typename T>
+  static typename ::std::enable_if<
+    !(is_member_pair<T>{} ||
+    is_const_member_pair<T>{}),
+    R
+  >::type
+  functor_stub(void* const object_ptr,
+    typename param_type<A>::type... args)
+  {
+    return (*static_cast<T*>(object_ptr))(::std::forward<A>(args)...);
+  }
+
+  template <typename T>
+  static typename ::std::enable_if<
+    is_member_pair<T>{} ||
+    is_const_member_pair<T>{},
+    R
+  >::type
+  functor_stub(void* const object_ptr,
+    typename param_type<A>::type... args)
+  {
+    return (static_cast<T*>(object_ptr)->first->*
+      static_cast<T*>(object_ptr)->second)(::std::forward<A>(args)...);
+  }
+};
+
+}
+
+namespace std
+{
+  template <typename R, typename ...A, class S>
+  struct hash<::generic::basic_delegate<R (A...), S> >
+  {
+    size_t operator()(
+      ::generic::basic_delegate<R (A...), S> const& d) const noexcept
+    {
+      auto const seed(hash<void*>()(d.store_.object()));
+
+      return hash<decltype(d.stub_ptr_)>()(d.stub_ptr_) +
+        0x9e3779b9 + (seed << 6) + (seed >> 2);
+    }
+  };
+}
+
+#endif // BASICDELEGATE_HPP
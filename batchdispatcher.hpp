@@ -0,0 +1,242 @@
+#ifndef BATCHDISPATCHER_HPP
+# define BATCHDISPATCHER_HPP
+# pragma once
+
+#include <cassert>
+
+#include <cstddef>
+
+#include <initializer_list>
+
+#include <type_traits>
+
+#include <unordered_map>
+
+#include <utility>
+
+#include <vector>
+
+#include "basicdelegate.hpp"
+
+namespace generic
+{
+
+// delegates are bucketed by their stub, each bucket is invoked in a tight
+// loop through the same stub, so the indirect call predicts well; the order
+// of invocation is the order of insertion within a bucket only
+template <typename D> class batch_dispatcher;
+
+template <class R, class ...A, class T>
+class batch_dispatcher<basic_delegate<R (A...), T> >
+{
+public:
+  using delegate_type = basic_delegate<R (A...), T>;
+
+private:
+  using stub_ptr_type = typename delegate_type::stub_ptr_type;
+
+  struct bucket
+  {
+    stub_ptr_type stub;
+
+    ::std::vector<delegate_type> delegates;
+
+    // the handle of every delegate
+    ::std::vector<::std::size_t> handles;
+  };
+
+  struct location
+  {
+    ::std::size_t bucket;
+    ::std::size_t slot;
+  };
+
+  // every delegate gets its own copy of by value and rvalue reference
+  // arguments
+  template <typename U>
+  static typename ::std::conditional<::std::is_lvalue_reference<U>{},
+    U,
+    typename ::std::decay<U>::type
+  >::type
+  pass(typename ::std::remove_reference<U>::type& a)
+  {
+    return a;
+  }
+
+  // room for one more element, growing geometrically
+  template <typename V>
+  static void reserve_one(V& v)
+  {
+    if (v.size() == v.capacity())
+    {
+      v.reserve(v.size() ? 2 * v.size() : 1);
+    }
+    // else do nothing
+  }
+
+public:
+  using handle_type = ::std::size_t;
+
+  // returned for empty delegates, removing it does nothing
+  static constexpr auto const npos = handle_type(-1);
+
+  batch_dispatcher() = default;
+
+  batch_dispatcher(::std::initializer_list<delegate_type> const l)
+  {
+    for (auto& d: l)
+    {
+      add(d);
+    }
+  }
+
+  void operator()(A... args) const { invoke_all(args...); }
+
+  // the handle stays valid until the delegate is removed, it may be reused
+  // afterwards; delegates, that own their functor, never compare equal to
+  // a copy, so they are removed by handle
+  handle_type add(delegate_type d)
+  {
+    if (d)
+    {
+      auto const i(index_.find(d.stub_ptr_));
+
+      auto const b(index_.end() == i ? buckets_.size() : i->second);
+
+      if (buckets_.size() == b)
+      {
+        buckets_.push_back({d.stub_ptr_, {}, {}});
+
+        try
+        {
+          index_.emplace(d.stub_ptr_, b);
+        }
+        catch (...)
+        {
+          buckets_.pop_back();
+
+          throw;
+        }
+      }
+      // else do nothing
+
+      auto& k(buckets_[b]);
+
+      // nothing below throws, once the delegate is in
+      if (free_.empty())
+      {
+        reserve_one(locations_);
+
+        // so that remove() never reallocates
+        free_.reserve(locations_.capacity());
+      }
+      // else do nothing
+
+      reserve_one(k.handles);
+      k.delegates.push_back(::std::move(d));
+
+      handle_type h;
+
+      if (free_.empty())
+      {
+        h = locations_.size();
+
+        locations_.push_back({b, k.handles.size()});
+      }
+      else
+      {
+        h = free_.back();
+        free_.pop_back();
+
+        locations_[h] = {b, k.handles.size()};
+      }
+
+      k.handles.push_back(h);
+
+      ++size_;
+
+      return h;
+    }
+    else
+    {
+      return npos;
+    }
+  }
+
+  bool remove(handle_type const h)
+  {
+    if ((h < locations_.size()) && (npos != locations_[h].bucket))
+    {
+      auto const l(locations_[h]);
+
+      auto& k(buckets_[l.bucket]);
+
+      k.delegates.erase(k.delegates.begin() + l.slot);
+      k.handles.erase(k.handles.begin() + l.slot);
+
+      // the delegates behind it moved up by one
+      for (auto i(l.slot); i != k.handles.size(); ++i)
+      {
+        locations_[k.handles[i]].slot = i;
+      }
+
+      locations_[h].bucket = npos;
+      free_.push_back(h);
+
+      --size_;
+
+      return true;
+    }
+    else
+    {
+      return false;
+    }
+  }
+
+  void invoke_all(A... args) const
+  {
+    for (auto& b: buckets_)
+    {
+      auto const stub(b.stub);
+
+      for (auto& d: b.delegates)
+      {
+        stub(d.store_.object(), pass<A>(args)...);
+      }
+    }
+  }
+
+  void clear() noexcept
+  {
+    buckets_.clear();
+    index_.clear();
+
+    locations_.clear();
+    free_.clear();
+
+    size_ = {};
+  }
+
+  bool empty() const noexcept { return !size_; }
+
+  ::std::size_t size() const noexcept { return size_; }
+
+  // the number of distinct stubs
+  ::std::size_t buckets() const noexcept { return buckets_.size(); }
+
+private:
+  ::std::vector<bucket> buckets_;
+
+  ::std::unordered_map<stub_ptr_type, ::std::size_t> index_;
+
+  // handle -> position of the delegate
+  ::std::vector<location> locations_;
+
+  ::std::vector<handle_type> free_;
+
+  ::std::size_t size_{};
+};
+
+}
+
+#endif // BATCHDISPATCHER_HPP
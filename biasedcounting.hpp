@@ -0,0 +1,488 @@
+#ifndef BIASEDCOUNTING_HPP
+# define BIASEDCOUNTING_HPP
+# pragma once
+
+#include <cassert>
+
+#include <atomic>
+
+#include <memory>
+
+#include <mutex>
+
+#include <vector>
+
+#include "lightptr.hpp"
+
+namespace generic
+{
+
+class biased_counting;
+
+namespace detail
+{
+
+// the per thread record of biased counts; counts, that other threads left
+// negative, are queued here for the owner to merge
+template <typename = void>
+class biased_owner
+{
+public:
+  // the record of this thread, nullptr once the thread is exiting
+  static biased_owner* attach();
+
+  static biased_owner* current() noexcept { return current_; }
+
+  void link(biased_counting* c) noexcept;
+
+  void unlink(biased_counting* c) noexcept;
+
+  // folds b into the atomic count of c, returns true, if no references are
+  // left
+  bool merge(biased_counting* c, long long b) noexcept;
+
+  // drops a reference to c, that the owner may hold in its plain count,
+  // returns true, if it was the last one
+  bool dec(biased_counting* c) noexcept;
+
+  void drain();
+
+private:
+  struct holder
+  {
+    biased_owner* o_;
+
+    holder();
+
+    ~holder();
+  };
+
+  // unmerged counts of this thread
+  biased_counting* head_{};
+
+  ::std::mutex m_;
+
+  biased_counting* queue_{};
+
+  ::std::atomic<bool> pending_{};
+
+  static thread_local biased_owner* current_;
+
+  static thread_local bool exited_;
+
+  static ::std::mutex free_m_;
+
+  // records are recycled, but never freed, other threads may still lock
+  // them
+  static ::std::vector<::std::unique_ptr<biased_owner> > free_;
+};
+
+template <typename T>
+thread_local biased_owner<T>* biased_owner<T>::current_;
+
+template <typename T>
+thread_local bool biased_owner<T>::exited_;
+
+template <typename T>
+::std::mutex biased_owner<T>::free_m_;
+
+template <typename T>
+::std::vector<::std::unique_ptr<biased_owner<T> > > biased_owner<T>::free_;
+
+template <>
+struct weak_counting<biased_counting>
+{
+  using type = atomic_counting;
+};
+
+}
+
+// biased reference counting: the creating thread counts in a plain integer,
+// other threads in an atomic one; the plain count is merged into the atomic
+// one, when the creating thread drops its last reference, when it exits, or
+// when another thread leaves the atomic count negative, on the next
+// creation of a biased count by the creating thread or its next
+// merge_biased_counts(); a count, that starts at zero, is atomic from the
+// start
+class biased_counting
+{
+  template <typename> friend class detail::biased_owner;
+
+  using shared_type = long long;
+
+  // the atomic count is kept as count * one + flags
+  static constexpr shared_type merged_bit = 1;
+  static constexpr shared_type queued_bit = 2;
+
+  static constexpr shared_type one = 4;
+
+  detail::biased_owner<>* const owner_;
+
+  detail::counter_type biased_;
+
+  // only the owner writes these
+  bool merged_;
+
+  biased_counting* prev_{};
+  biased_counting* next_{};
+
+  biased_counting* queue_next_{};
+
+  ::std::atomic<shared_type> shared_;
+
+  void* object_{};
+  detail::release_type release_{};
+
+  static shared_type count(shared_type const v) noexcept
+  {
+    return (v - (v & (one - 1))) / one;
+  }
+
+  bool is_owner() const noexcept
+  {
+    return (owner_ == detail::biased_owner<>::current()) && !merged_;
+  }
+
+  // folds the plain count into the atomic one, returns true, if no
+  // references are left; the object may be gone, once the count is merged,
+  // so the bookkeeping comes first
+  bool merge() noexcept
+  {
+    shared_type const b(biased_);
+
+    biased_ = {};
+    merged_ = true;
+
+    owner_->unlink(this);
+
+    return owner_->merge(this, b);
+  }
+
+  void release() noexcept
+  {
+    assert(release_);
+    release_(object_);
+  }
+
+public:
+  explicit biased_counting(detail::counter_type const c) :
+    owner_(c ? detail::biased_owner<>::attach() : nullptr),
+    biased_(owner_ ? c : detail::counter_type{}),
+    merged_(!owner_),
+    shared_(owner_ ? shared_type{} : shared_type(c) * one + merged_bit)
+  {
+    if (owner_)
+    {
+      owner_->drain();
+
+      owner_->link(this);
+    }
+    // else do nothing
+  }
+
+  ~biased_counting()
+  {
+    if (is_owner())
+    {
+      owner_->unlink(this);
+    }
+    // else do nothing
+  }
+
+  biased_counting(biased_counting const&) = delete;
+
+  biased_counting& operator=(biased_counting const&) = delete;
+
+  void bind(void* const object, detail::release_type const release) noexcept
+  {
+    object_ = object;
+    release_ = release;
+  }
+
+  void inc() noexcept
+  {
+    if (is_owner())
+    {
+      ++biased_;
+    }
+    else
+    {
+      shared_.fetch_add(one, ::std::memory_order_relaxed);
+    }
+  }
+
+  bool dec() noexcept
+  {
+    if (is_owner())
+    {
+      return !--biased_ && merge();
+    }
+    // else do nothing
+
+    auto v(shared_.load(::std::memory_order_relaxed));
+
+    do
+    {
+      if (!(v & merged_bit) && (count(v) <= 0))
+      {
+        // the owner holds the rest in its plain count
+        return owner_->dec(this);
+      }
+      // else do nothing
+    }
+    while (!shared_.compare_exchange_weak(v, v - one,
+      ::std::memory_order_release, ::std::memory_order_relaxed));
+
+    if ((v & merged_bit) && (1 == count(v)))
+    {
+      ::std::atomic_thread_fence(::std::memory_order_acquire);
+
+      return true;
+    }
+    // else do nothing
+
+    return false;
+  }
+
+  bool inc_if_nonzero() noexcept
+  {
+    if (is_owner())
+    {
+      ++biased_;
+
+      return true;
+    }
+    // else do nothing
+
+    auto v(shared_.load(::std::memory_order_relaxed));
+
+    do
+    {
+      // an unmerged count is never released
+      if ((v & merged_bit) && !count(v))
+      {
+        return false;
+      }
+      // else do nothing
+    }
+    while (!shared_.compare_exchange_weak(v, v + one,
+      ::std::memory_order_acq_rel, ::std::memory_order_relaxed));
+
+    return true;
+  }
+
+  // exact on the owning thread only
+  detail::counter_type get() const noexcept
+  {
+    auto c(count(shared_.load(::std::memory_order_relaxed)));
+
+    if (is_owner())
+    {
+      c += biased_;
+    }
+    // else do nothing
+
+    return c > 0 ? detail::counter_type(c) : detail::counter_type{};
+  }
+};
+
+namespace detail
+{
+
+template <typename T>
+biased_owner<T>::holder::holder()
+{
+  {
+    ::std::lock_guard<::std::mutex> l(free_m_);
+
+    if (free_.empty())
+    {
+      o_ = nullptr;
+    }
+    else
+    {
+      o_ = free_.back().release();
+      free_.pop_back();
+    }
+  }
+
+  current_ = o_ ? o_ : (o_ = new biased_owner);
+}
+
+template <typename T>
+biased_owner<T>::holder::~holder()
+{
+  // what others queued, then everything else
+  o_->drain();
+
+  while (auto const c = o_->head_)
+  {
+    if (c->merge())
+    {
+      c->release();
+    }
+    // else do nothing
+  }
+
+  current_ = nullptr;
+  exited_ = true;
+
+  ::std::lock_guard<::std::mutex> l(free_m_);
+
+  free_.emplace_back(o_);
+}
+
+template <typename T>
+biased_owner<T>* biased_owner<T>::attach()
+{
+  if (!current_ && !exited_)
+  {
+    static thread_local holder const h;
+  }
+  // else do nothing
+
+  return current_;
+}
+
+template <typename T>
+void biased_owner<T>::link(biased_counting* const c) noexcept
+{
+  if ((c->next_ = head_))
+  {
+    head_->prev_ = c;
+  }
+  // else do nothing
+
+  head_ = c;
+}
+
+template <typename T>
+void biased_owner<T>::unlink(biased_counting* const c) noexcept
+{
+  if (c->prev_)
+  {
+    c->prev_->next_ = c->next_;
+  }
+  else
+  {
+    head_ = c->next_;
+  }
+
+  if (c->next_)
+  {
+    c->next_->prev_ = c->prev_;
+  }
+  // else do nothing
+
+  c->prev_ = c->next_ = nullptr;
+}
+
+template <typename T>
+bool biased_owner<T>::merge(biased_counting* const c, long long const b)
+  noexcept
+{
+  ::std::lock_guard<::std::mutex> l(m_);
+
+  auto const old(c->shared_.fetch_add(b * biased_counting::one +
+    biased_counting::merged_bit, ::std::memory_order_acq_rel));
+
+  if (old & biased_counting::queued_bit)
+  {
+    for (auto p(&queue_); *p; p = &(*p)->queue_next_)
+    {
+      if (c == *p)
+      {
+        *p = c->queue_next_;
+
+        break;
+      }
+      // else do nothing
+    }
+  }
+  // else do nothing
+
+  return !(biased_counting::count(old) + b);
+}
+
+template <typename T>
+bool biased_owner<T>::dec(biased_counting* const c) noexcept
+{
+  // the queued bit and the queue only change under the lock, so the owner
+  // can not merge, and release, c meanwhile
+  ::std::lock_guard<::std::mutex> l(m_);
+
+  auto const old(c->shared_.fetch_sub(biased_counting::one,
+    ::std::memory_order_acq_rel));
+
+  if (old & biased_counting::merged_bit)
+  {
+    return 1 == biased_counting::count(old);
+  }
+  else if (!(old & biased_counting::queued_bit) &&
+    (biased_counting::count(old) <= 0))
+  {
+    c->shared_.fetch_or(biased_counting::queued_bit,
+      ::std::memory_order_relaxed);
+
+    c->queue_next_ = queue_;
+    queue_ = c;
+
+    pending_.store(true, ::std::memory_order_relaxed);
+  }
+  // else do nothing
+
+  return false;
+}
+
+template <typename T>
+void biased_owner<T>::drain()
+{
+  if (pending_.load(::std::memory_order_relaxed))
+  {
+    for (;;)
+    {
+      biased_counting* c;
+
+      {
+        ::std::lock_guard<::std::mutex> l(m_);
+
+        if (!(c = queue_))
+        {
+          pending_.store(false, ::std::memory_order_relaxed);
+
+          break;
+        }
+        // else do nothing
+
+        queue_ = c->queue_next_;
+
+        c->shared_.fetch_and(~biased_counting::queued_bit,
+          ::std::memory_order_relaxed);
+      }
+
+      // only the owner releases an unmerged count, c is still there
+      if (c->merge())
+      {
+        c->release();
+      }
+      // else do nothing
+    }
+  }
+  // else do nothing
+}
+
+}
+
+// merges the counts, that other threads queued for this thread
+inline void merge_biased_counts()
+{
+  if (auto const o = detail::biased_owner<>::current())
+  {
+    o->drain();
+  }
+  // else do nothing
+}
+
+}
+
+#endif // BIASEDCOUNTING_HPP
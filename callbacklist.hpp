@@ -0,0 +1,342 @@
+#ifndef CALLBACKLIST_HPP
+# define CALLBACKLIST_HPP
+# pragma once
+
+#include <cassert>
+
+#include <cstddef>
+
+#include <cstring>
+
+#include <algorithm>
+
+#include <memory>
+
+#include <new>
+
+#include <type_traits>
+
+#include <utility>
+
+#include <vector>
+
+namespace generic
+{
+
+// callbacks are packed back to back into a single buffer, each behind a
+// small header, so invoking all of them is a linear sweep; removed callbacks
+// leave holes, that are squeezed out when the buffer is rebuilt
+//
+// arguments are passed to every callback as lvalues, callbacks must not
+// modify the list they are in
+template <typename F> class callback_list;
+
+template <class R, class ...A>
+class callback_list<R (A...)>
+{
+  static constexpr auto const align = alignof(::std::max_align_t);
+
+  using storage_type = typename ::std::aligned_storage<align, align>::type;
+
+  using stub_ptr_type = R (*)(void*,
+    typename ::std::add_lvalue_reference<A>::type...);
+
+  // trivially copyable callbacks have no ops, they are relocated bytewise
+  struct ops_type
+  {
+    void (*destroy)(void*);
+
+    void (*relocate)(void*, void*);
+  };
+
+  struct header
+  {
+    stub_ptr_type stub; // nullptr, if removed
+
+    ops_type const* ops;
+
+    ::std::size_t size; // including the header
+
+    ::std::size_t slot;
+  };
+
+  static constexpr auto const header_size =
+    (sizeof(header) + align - 1) / align * align;
+
+public:
+  using handle_type = ::std::size_t;
+
+  callback_list() = default;
+
+  callback_list(callback_list const&) = delete;
+
+  callback_list(callback_list&& other) noexcept { swap(other); }
+
+  ~callback_list() { clear(); }
+
+  callback_list& operator=(callback_list const&) = delete;
+
+  callback_list& operator=(callback_list&& rhs) noexcept
+  {
+    swap(rhs);
+
+    return *this;
+  }
+
+  void operator()(A... args) const
+  {
+    invoke_all(::std::forward<A>(args)...);
+  }
+
+  // the handle stays valid until the callback is removed, it may be reused
+  // afterwards
+  template <typename T>
+  handle_type add(T&& f)
+  {
+    using functor_type = typename ::std::decay<T>::type;
+
+    static_assert(alignof(functor_type) <= align, "functor over-aligned");
+    static_assert(::std::is_nothrow_move_constructible<functor_type>{},
+      "functor has to be nothrow move constructible");
+
+    auto const n(header_size + round(sizeof(functor_type)));
+
+    if (capacity_ - size_ < n)
+    {
+      auto const live(size_ - dead_);
+
+      // rebuild into a buffer of the same capacity, squeezing out the
+      // holes, unless it would be more than half full, then double it
+      rebuild(live + n > capacity_ / 2 ?
+        ::std::max(2 * capacity_, live + n) :
+        capacity_);
+    }
+    // else do nothing
+
+    auto const slot(free_.empty() ? offsets_.size() : free_.back());
+
+    if (free_.empty())
+    {
+      offsets_.push_back(size_);
+
+      // so that remove() never reallocates
+      free_.reserve(offsets_.size());
+    }
+    else
+    {
+      offsets_[slot] = size_;
+    }
+
+    auto const p(data() + size_);
+
+    new (p + header_size) functor_type(::std::forward<T>(f));
+
+    new (p) header{
+      functor_stub<functor_type>,
+      ::std::is_trivially_copyable<functor_type>{} ?
+        nullptr :
+        functor_ops<functor_type>(),
+      n,
+      slot
+    };
+
+    if (!free_.empty())
+    {
+      free_.pop_back();
+    }
+    // else do nothing
+
+    size_ += n;
+    ++count_;
+
+    return slot;
+  }
+
+  void remove(handle_type const h) noexcept
+  {
+    assert(h < offsets_.size());
+    auto const p(data() + offsets_[h]);
+
+    auto& hdr(*reinterpret_cast<header*>(p));
+    assert(hdr.stub);
+
+    if (hdr.ops)
+    {
+      hdr.ops->destroy(p + header_size);
+    }
+    // else do nothing
+
+    hdr.stub = nullptr;
+
+    dead_ += hdr.size;
+    --count_;
+
+    free_.push_back(h);
+  }
+
+  void invoke_all(A... args) const
+  {
+    for (auto i(data()), end(i + size_); i != end;)
+    {
+      auto const& hdr(*reinterpret_cast<header const*>(i));
+
+      if (hdr.stub)
+      {
+        hdr.stub(i + header_size, args...);
+      }
+      // else do nothing
+
+      i += hdr.size;
+    }
+  }
+
+  // squeezes out the holes left by removed callbacks
+  void compact() { rebuild(size_ - dead_); }
+
+  void clear() noexcept
+  {
+    for (auto i(data()), end(i + size_); i != end;)
+    {
+      auto const& hdr(*reinterpret_cast<header const*>(i));
+
+      if (hdr.stub && hdr.ops)
+      {
+        hdr.ops->destroy(i + header_size);
+      }
+      // else do nothing
+
+      i += hdr.size;
+    }
+
+    size_ = dead_ = count_ = {};
+
+    offsets_.clear();
+    free_.clear();
+  }
+
+  bool empty() const noexcept { return !count_; }
+
+  ::std::size_t size() const noexcept { return count_; }
+
+  // in bytes
+  ::std::size_t capacity() const noexcept { return capacity_; }
+
+  void swap(callback_list& other) noexcept
+  {
+    buffer_.swap(other.buffer_);
+
+    ::std::swap(capacity_, other.capacity_);
+    ::std::swap(size_, other.size_);
+    ::std::swap(dead_, other.dead_);
+    ::std::swap(count_, other.count_);
+
+    offsets_.swap(other.offsets_);
+    free_.swap(other.free_);
+  }
+
+private:
+  ::std::unique_ptr<storage_type[]> buffer_;
+
+  ::std::size_t capacity_{};
+  ::std::size_t size_{};
+  ::std::size_t dead_{};
+  ::std::size_t count_{};
+
+  // handle -> offset of the callback in buffer_
+  ::std::vector<::std::size_t> offsets_;
+
+  ::std::vector<handle_type> free_;
+
+  static constexpr ::std::size_t round(::std::size_t const n) noexcept
+  {
+    return (n + align - 1) / align * align;
+  }
+
+  char* data() const noexcept
+  {
+    return reinterpret_cast<char*>(buffer_.get());
+  }
+
+  // moves the live callbacks into a new buffer, the old one is freed
+  void rebuild(::std::size_t const capacity)
+  {
+    assert(capacity >= size_ - dead_);
+    ::std::unique_ptr<storage_type[]> buffer(capacity ?
+      new storage_type[capacity / align] :
+      nullptr);
+
+    auto const dst(reinterpret_cast<char*>(buffer.get()));
+
+    ::std::size_t size{};
+
+    for (auto i(data()), end(i + size_); i != end;)
+    {
+      auto const& hdr(*reinterpret_cast<header const*>(i));
+
+      if (hdr.stub)
+      {
+        auto const p(dst + size);
+
+        if (hdr.ops)
+        {
+          hdr.ops->relocate(p + header_size, i + header_size);
+        }
+        else
+        {
+          ::std::memcpy(p + header_size, i + header_size,
+            hdr.size - header_size);
+        }
+
+        new (p) header(hdr);
+
+        offsets_[hdr.slot] = size;
+
+        size += hdr.size;
+      }
+      // else do nothing
+
+      i += hdr.size;
+    }
+
+    buffer_.swap(buffer);
+
+    capacity_ = capacity;
+    size_ = size;
+    dead_ = {};
+  }
+
+  template <typename T>
+  static ops_type const* functor_ops() noexcept
+  {
+    static constexpr ops_type const ops{
+      destroy_stub<T>, relocate_stub<T>
+    };
+
+    return &ops;
+  }
+
+  template <typename T>
+  static void destroy_stub(void* const p)
+  {
+    static_cast<T*>(p)->~T();
+  }
+
+  template <typename T>
+  static void relocate_stub(void* const dst, void* const src)
+  {
+    new (dst) T(::std::move(*static_cast<T*>(src)));
+
+    static_cast<T*>(src)->~T();
+  }
+
+  template <typename T>
+  static R functor_stub(void* const p,
+    typename ::std::add_lvalue_reference<A>::type... args)
+  {
+    return (*static_cast<T*>(p))(args...);
+  }
+};
+
+}
+
+#endif // CALLBACKLIST_HPP
@@ -0,0 +1,224 @@
+#ifndef COMPACTLIGHTPTR_HPP
+# define COMPACTLIGHTPTR_HPP
+# pragma once
+
+#include <cassert>
+
+#include <cstddef>
+
+#include <functional>
+
+#include <new>
+
+#include <type_traits>
+
+#include <utility>
+
+#include "lightptr.hpp"
+
+namespace generic
+{
+
+template <typename T, class P = atomic_counting>
+class compact_light_ptr;
+
+namespace detail
+{
+  template <typename T, class P>
+  struct compact_factory;
+}
+
+// one pointer wide, it points to a block holding both the count and the
+// object; there is no aliasing, no deleter, no conversion to a base and no
+// weak pointer, objects come from make_compact_light() only
+template <typename T, class P>
+class compact_light_ptr
+{
+  static_assert(!::std::is_array<T>{}, "arrays are not supported");
+
+  friend struct detail::compact_factory<T, P>;
+
+  template <typename U> friend struct ::std::hash;
+
+  class block
+  {
+    P counter_;
+
+    typename ::std::aligned_storage<sizeof(T), alignof(T)>::type store_;
+
+    static void release(void* const ptr)
+    {
+      auto const b(static_cast<block*>(ptr));
+
+      b->get()->~T();
+
+      delete b;
+    }
+
+  public:
+    template <typename ...A>
+    explicit block(A&& ...args) :
+      counter_(detail::counter_type(1))
+    {
+      new (static_cast<void*>(&store_)) T(::std::forward<A>(args)...);
+
+      detail::bind_release(counter_, this, release, 0);
+    }
+
+    T* get() noexcept { return reinterpret_cast<T*>(&store_); }
+
+    void inc_ref() noexcept { counter_.inc(); }
+
+    void dec_ref()
+    {
+      if (counter_.dec())
+      {
+        release(this);
+      }
+      // else do nothing
+    }
+
+    detail::counter_type use_count() const noexcept
+    {
+      return counter_.get();
+    }
+  };
+
+  block* block_{};
+
+  explicit compact_light_ptr(block* const b) noexcept : block_(b) { }
+
+public:
+  using element_type = T;
+
+  compact_light_ptr() = default;
+
+  compact_light_ptr(::std::nullptr_t const) noexcept { }
+
+  compact_light_ptr(compact_light_ptr const& other) noexcept :
+    block_(other.block_)
+  {
+    if (block_)
+    {
+      block_->inc_ref();
+    }
+    // else do nothing
+  }
+
+  compact_light_ptr(compact_light_ptr&& other) noexcept :
+    block_(other.block_)
+  {
+    other.block_ = nullptr;
+  }
+
+  ~compact_light_ptr()
+  {
+    if (block_)
+    {
+      block_->dec_ref();
+    }
+    // else do nothing
+  }
+
+  compact_light_ptr& operator=(compact_light_ptr const& rhs)
+  {
+    compact_light_ptr(rhs).swap(*this);
+
+    return *this;
+  }
+
+  compact_light_ptr& operator=(compact_light_ptr&& rhs) noexcept
+  {
+    compact_light_ptr(::std::move(rhs)).swap(*this);
+
+    return *this;
+  }
+
+  compact_light_ptr& operator=(::std::nullptr_t const)
+  {
+    reset();
+
+    return *this;
+  }
+
+  bool operator<(compact_light_ptr const& rhs) const noexcept
+  {
+    return ::std::less<block*>()(block_, rhs.block_);
+  }
+
+  bool operator==(compact_light_ptr const& rhs) const noexcept
+  {
+    return block_ == rhs.block_;
+  }
+
+  bool operator!=(compact_light_ptr const& rhs) const noexcept
+  {
+    return !operator==(rhs);
+  }
+
+  bool operator==(::std::nullptr_t const) const noexcept { return !block_; }
+
+  bool operator!=(::std::nullptr_t const) const noexcept { return block_; }
+
+  explicit operator bool() const noexcept { return block_; }
+
+  T& operator*() const noexcept { return *get(); }
+
+  T* operator->() const noexcept { return get(); }
+
+  T* get() const noexcept { return block_ ? block_->get() : nullptr; }
+
+  void reset() { compact_light_ptr().swap(*this); }
+
+  void swap(compact_light_ptr& other) noexcept
+  {
+    ::std::swap(block_, other.block_);
+  }
+
+  bool unique() const noexcept
+  {
+    return detail::counter_type(1) == use_count();
+  }
+
+  detail::counter_type use_count() const noexcept
+  {
+    return block_ ? block_->use_count() : detail::counter_type{};
+  }
+};
+
+namespace detail
+{
+  template <typename T, class P>
+  struct compact_factory
+  {
+    template <typename ...A>
+    static compact_light_ptr<T, P> make(A&& ...args)
+    {
+      return compact_light_ptr<T, P>(new typename compact_light_ptr<T, P>::
+        block(::std::forward<A>(args)...));
+    }
+  };
+}
+
+template<class T, class P = atomic_counting, class ...Args>
+inline compact_light_ptr<T, P> make_compact_light(Args&& ...args)
+{
+  return detail::compact_factory<T, P>::make(::std::forward<Args>(args)...);
+}
+
+}
+
+namespace std
+{
+  template <typename T, class P>
+  struct hash<::generic::compact_light_ptr<T, P> >
+  {
+    size_t operator()(::generic::compact_light_ptr<T, P> const& l) const
+      noexcept
+    {
+      return hash<void const*>()(l.block_);
+    }
+  };
+}
+
+#endif // COMPACTLIGHTPTR_HPP
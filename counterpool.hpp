@@ -0,0 +1,226 @@
+#ifndef COUNTERPOOL_HPP
+# define COUNTERPOOL_HPP
+# pragma once
+
+#include <cstddef>
+
+#include <mutex>
+
+#include <new>
+
+namespace generic
+{
+
+namespace detail
+{
+
+// size class free lists for small blocks, e.g. light_ptr counters; every
+// thread keeps its own lists, a list that grows too long spills half of its
+// blocks into a global list, from which empty lists are refilled; blocks are
+// never returned to the heap, larger blocks bypass the pool
+template <typename = void>
+class counter_pool
+{
+public:
+  static constexpr ::std::size_t granularity = 16;
+
+  static constexpr ::std::size_t classes = 8;
+
+  // blocks per thread and size class, before spilling
+  static constexpr ::std::size_t local_limit = 256;
+
+  static void* allocate(::std::size_t const size)
+  {
+    if (size <= classes * granularity)
+    {
+      auto const i(index(size));
+
+      if (!exited_)
+      {
+        auto& l(local().lists_[i]);
+
+        if (l.head_ || refill(l, i))
+        {
+          auto const b(l.head_);
+
+          l.head_ = b->next_;
+          --l.size_;
+
+          return b;
+        }
+        // else do nothing
+      }
+      // else do nothing
+
+      return ::operator new((i + 1) * granularity);
+    }
+    else
+    {
+      return ::operator new(size);
+    }
+  }
+
+  static void deallocate(void* const p, ::std::size_t const size) noexcept
+  {
+    if ((size <= classes * granularity) && !exited_)
+    {
+      auto const i(index(size));
+
+      auto& l(local().lists_[i]);
+
+      auto const b(static_cast<block*>(p));
+
+      b->next_ = l.head_;
+      l.head_ = b;
+
+      if (++l.size_ > local_limit)
+      {
+        spill(l, i, local_limit / 2);
+      }
+      // else do nothing
+    }
+    else if (size <= classes * granularity)
+    {
+      // the thread is exiting, hand the block over directly
+      auto const b(static_cast<block*>(p));
+
+      b->next_ = {};
+
+      push(b, index(size));
+    }
+    else
+    {
+      ::operator delete(p);
+    }
+  }
+
+private:
+  // the first block of a spilled batch links the batches
+  struct block
+  {
+    block* next_;
+
+    block* next_batch_;
+  };
+
+  struct list
+  {
+    block* head_{};
+
+    ::std::size_t size_{};
+  };
+
+  struct local_lists
+  {
+    list lists_[classes];
+
+    ~local_lists()
+    {
+      exited_ = true;
+
+      for (::std::size_t i{}; i != classes; ++i)
+      {
+        if (lists_[i].size_)
+        {
+          spill(lists_[i], i, lists_[i].size_);
+        }
+        // else do nothing
+      }
+    }
+  };
+
+  struct global_lists
+  {
+    ::std::mutex m_;
+
+    block* batches_[classes]{};
+  };
+
+  static thread_local bool exited_;
+
+  static constexpr ::std::size_t index(::std::size_t const size) noexcept
+  {
+    return size ? (size - 1) / granularity : 0;
+  }
+
+  static local_lists& local()
+  {
+    static thread_local local_lists l;
+
+    return l;
+  }
+
+  // never destroyed, counters may outlive static objects
+  static global_lists& global()
+  {
+    static auto const g(new global_lists);
+
+    return *g;
+  }
+
+  // moves the first n blocks of l into a global batch
+  static void spill(list& l, ::std::size_t const i, ::std::size_t const n)
+    noexcept
+  {
+    auto const head(l.head_);
+
+    auto tail(head);
+
+    for (auto j(n); --j;)
+    {
+      tail = tail->next_;
+    }
+
+    l.head_ = tail->next_;
+    l.size_ -= n;
+
+    tail->next_ = {};
+
+    push(head, i);
+  }
+
+  static void push(block* const b, ::std::size_t const i) noexcept
+  {
+    auto& g(global());
+
+    ::std::lock_guard<::std::mutex> l(g.m_);
+
+    b->next_batch_ = g.batches_[i];
+    g.batches_[i] = b;
+  }
+
+  static bool refill(list& l, ::std::size_t const i)
+  {
+    {
+      auto& g(global());
+
+      ::std::lock_guard<::std::mutex> lock(g.m_);
+
+      if (!(l.head_ = g.batches_[i]))
+      {
+        return false;
+      }
+      // else do nothing
+
+      g.batches_[i] = l.head_->next_batch_;
+    }
+
+    l.size_ = {};
+
+    for (auto b(l.head_); b; b = b->next_)
+    {
+      ++l.size_;
+    }
+
+    return true;
+  }
+};
+
+template <typename T>
+thread_local bool counter_pool<T>::exited_;
+
+}
+
+}
+
+#endif // COUNTERPOOL_HPP
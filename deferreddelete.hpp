@@ -0,0 +1,216 @@
+#ifndef DEFERREDDELETE_HPP
+# define DEFERREDDELETE_HPP
+# pragma once
+
+#include <cstddef>
+
+#include <condition_variable>
+
+#include <memory>
+
+#include <mutex>
+
+#include <thread>
+
+#include <type_traits>
+
+#include <utility>
+
+#include <vector>
+
+#include "lightptr.hpp"
+
+namespace generic
+{
+
+// destroys objects on a background thread; the queue is bounded, when it is
+// full, defer() fails and the caller has to destroy the object itself; the
+// thread takes the whole queue at once and destroys it outside of the lock
+class reclaimer
+{
+public:
+  using deleter_type = void (*)(void*);
+
+  explicit reclaimer(::std::size_t const capacity = 4096) :
+    capacity_(capacity)
+  {
+    queue_.reserve(capacity_);
+
+    thread_ = ::std::thread([this]() { run(); });
+  }
+
+  // destroys whatever is still queued, producers have to be done by then
+  ~reclaimer()
+  {
+    {
+      ::std::lock_guard<decltype(m_)> l(m_);
+
+      stop_ = true;
+    }
+
+    cv_.notify_one();
+
+    thread_.join();
+  }
+
+  reclaimer(reclaimer const&) = delete;
+
+  reclaimer& operator=(reclaimer const&) = delete;
+
+  // returns false, if the queue is full or the reclaimer is stopping
+  bool defer(void* const p, deleter_type const d)
+  {
+    bool wake;
+
+    {
+      ::std::lock_guard<decltype(m_)> l(m_);
+
+      if (stop_ || (capacity_ == queue_.size()))
+      {
+        return false;
+      }
+      // else do nothing
+
+      queue_.push_back({p, d});
+
+      // the thread only sleeps on an empty queue
+      wake = 1 == queue_.size();
+    }
+
+    if (wake)
+    {
+      cv_.notify_one();
+    }
+    // else do nothing
+
+    return true;
+  }
+
+  // waits, until everything queued so far is destroyed; must not be called
+  // from a deleter
+  void flush()
+  {
+    ::std::unique_lock<decltype(m_)> l(m_);
+
+    while (!queue_.empty() || busy_)
+    {
+      done_cv_.wait(l);
+    }
+  }
+
+  // never destroyed, so threads, that release objects during static
+  // destruction, can still use it; it is flushed at exit, objects queued
+  // after that are not destroyed
+  static reclaimer& global()
+  {
+    struct holder
+    {
+      reclaimer* const r{new reclaimer};
+
+      ~holder() { r->flush(); }
+    };
+
+    static holder const h;
+
+    return *h.r;
+  }
+
+private:
+  struct entry
+  {
+    void* p;
+    deleter_type d;
+  };
+
+  ::std::size_t const capacity_;
+
+  ::std::mutex m_;
+  ::std::condition_variable cv_;
+  ::std::condition_variable done_cv_;
+
+  bool stop_{};
+
+  // a batch is being destroyed
+  bool busy_{};
+
+  ::std::vector<entry> queue_;
+
+  ::std::thread thread_;
+
+  void run()
+  {
+    decltype(queue_) batch;
+
+    batch.reserve(capacity_);
+
+    for (;;)
+    {
+      {
+        ::std::unique_lock<decltype(m_)> l(m_);
+
+        while (!stop_ && queue_.empty())
+        {
+          cv_.wait(l);
+        }
+
+        if (queue_.empty())
+        {
+          break;
+        }
+        // else do nothing
+
+        // both keep their capacity
+        batch.swap(queue_);
+
+        busy_ = true;
+      }
+
+      for (auto& e: batch)
+      {
+        e.d(e.p);
+      }
+
+      batch.clear();
+
+      {
+        ::std::lock_guard<decltype(m_)> l(m_);
+
+        busy_ = false;
+      }
+
+      done_cv_.notify_all();
+    }
+  }
+};
+
+// a light_ptr deleter, that hands the object to the global reclaimer, so
+// the thread dropping the last reference pays for an enqueue only; if the
+// queue is full, the object is destroyed in place; D has to be stateless
+template <typename T, class D = ::std::default_delete<T> >
+struct deferred_delete
+{
+  static_assert(::std::is_empty<D>{}, "D has to be stateless");
+
+  void operator()(T* const p) const
+  {
+    if (!reclaimer::global().defer(p, destroy))
+    {
+      D()(p);
+    }
+    // else do nothing
+  }
+
+private:
+  static void destroy(void* const p) { D()(static_cast<T*>(p)); }
+};
+
+template <class T, class P = atomic_counting, class ...Args>
+inline light_ptr<T, P> make_light_deferred(Args&& ...args)
+{
+  return light_ptr<T, P>(new T(::std::forward<Args>(args)...),
+    deferred_delete<T>());
+}
+
+}
+
+#endif // DEFERREDDELETE_HPP
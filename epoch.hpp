@@ -0,0 +1,224 @@
+#ifndef EPOCH_HPP
+# define EPOCH_HPP
+# pragma once
+
+#include <algorithm>
+
+#include <atomic>
+
+#include <limits>
+
+#include <mutex>
+
+#include <vector>
+
+namespace generic
+{
+
+namespace detail
+{
+
+// epoch based reclamation: readers pin the global epoch for the duration of
+// a call, retired objects are deleted once no pinned reader can reach them
+template <typename = void>
+class epoch
+{
+public:
+  using epoch_type = unsigned long long;
+
+  using deleter_type = void (*)(void*);
+
+  class guard
+  {
+  public:
+    guard() noexcept
+    {
+      auto& l(local());
+
+      if (!l.depth_++)
+      {
+        l.record_->epoch_.store(global_.load(::std::memory_order_relaxed),
+          ::std::memory_order_relaxed);
+
+        ::std::atomic_thread_fence(::std::memory_order_seq_cst);
+      }
+      // else do nothing
+    }
+
+    ~guard()
+    {
+      auto& l(local());
+
+      if (!--l.depth_)
+      {
+        l.record_->epoch_.store(epoch_type{}, ::std::memory_order_release);
+      }
+      // else do nothing
+    }
+
+    guard(guard const&) = delete;
+
+    guard& operator=(guard const&) = delete;
+  };
+
+  static void retire(void* const p, deleter_type const d)
+  {
+    auto const e(global_.fetch_add(epoch_type(1)));
+
+    {
+      ::std::lock_guard<decltype(m_)> l(m_);
+
+      retired_.push_back({p, d, e});
+    }
+
+    collect();
+  }
+
+  static void collect()
+  {
+    ::std::vector<retired> reclaimable;
+
+    {
+      ::std::lock_guard<decltype(m_)> l(m_);
+
+      auto const min(min_epoch());
+
+      auto const i(::std::partition(retired_.begin(), retired_.end(),
+        [min](retired const& r) noexcept { return r.when >= min; }));
+
+      reclaimable.assign(i, retired_.end());
+      retired_.erase(i, retired_.end());
+    }
+
+    for (auto& r: reclaimable)
+    {
+      r.deleter(r.p);
+    }
+  }
+
+private:
+  struct record
+  {
+    ::std::atomic<epoch_type> epoch_{};
+
+    ::std::atomic_flag used_ = ATOMIC_FLAG_INIT;
+
+    record* next_{};
+  };
+
+  struct local_record
+  {
+    record* record_;
+
+    unsigned depth_{};
+
+    local_record()
+    {
+      for (auto r(records_.load(::std::memory_order_acquire)); r;
+        r = r->next_)
+      {
+        if (!r->used_.test_and_set(::std::memory_order_acquire))
+        {
+          record_ = r;
+
+          return;
+        }
+        // else do nothing
+      }
+
+      record_ = new record;
+      record_->used_.test_and_set(::std::memory_order_relaxed);
+
+      record_->next_ = records_.load(::std::memory_order_relaxed);
+
+      while (!records_.compare_exchange_weak(record_->next_, record_,
+        ::std::memory_order_release, ::std::memory_order_relaxed));
+    }
+
+    ~local_record()
+    {
+      record_->epoch_.store(epoch_type{}, ::std::memory_order_relaxed);
+
+      record_->used_.clear(::std::memory_order_release);
+    }
+  };
+
+  struct retired
+  {
+    void* p;
+    deleter_type deleter;
+    epoch_type when;
+  };
+
+  // whatever is still retired at exit is deleted then
+  struct retired_list : ::std::vector<retired>
+  {
+    ~retired_list()
+    {
+      // deleters may retire more
+      while (!this->empty())
+      {
+        ::std::vector<retired> r;
+
+        r.swap(*this);
+
+        for (auto& e: r)
+        {
+          e.deleter(e.p);
+        }
+      }
+    }
+  };
+
+  static local_record& local()
+  {
+    static thread_local local_record l;
+
+    return l;
+  }
+
+  static epoch_type min_epoch() noexcept
+  {
+    auto min(::std::numeric_limits<epoch_type>::max());
+
+    for (auto r(records_.load(::std::memory_order_acquire)); r;
+      r = r->next_)
+    {
+      auto const e(r->epoch_.load());
+
+      if (e && (e < min))
+      {
+        min = e;
+      }
+      // else do nothing
+    }
+
+    return min;
+  }
+
+  static ::std::atomic<epoch_type> global_;
+
+  static ::std::atomic<record*> records_;
+
+  static ::std::mutex m_;
+
+  static retired_list retired_;
+};
+
+template <typename T>
+::std::atomic<typename epoch<T>::epoch_type> epoch<T>::global_{1};
+
+template <typename T>
+::std::atomic<typename epoch<T>::record*> epoch<T>::records_;
+
+template <typename T>
+::std::mutex epoch<T>::m_;
+
+template <typename T>
+typename epoch<T>::retired_list epoch<T>::retired_;
+
+}
+
+}
+
+#endif // EPOCH_HPP
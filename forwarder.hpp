@@ -8,40 +8,112 @@
 
 #include <cstdint>
 
+#include <cstring>
+
+#include <new>
+
 #include <type_traits>
 
 #include <utility>
 
+#include "meta.hpp"
+
 namespace generic
 {
 
-template<typename F, ::std::size_t N = 4 * sizeof(::std::uintptr_t)>
+// if S is set, functors, that do not fit into N bytes, spill to the heap,
+// otherwise they fail to compile
+template<typename F, ::std::size_t N = 4 * sizeof(::std::uintptr_t),
+  bool S = false>
 class forwarder;
 
-template<typename R, typename ...A, ::std::size_t N>
-class forwarder<R (A...), N>
+template<typename R, typename ...A, ::std::size_t N, bool S>
+class forwarder<R (A...), N, S>
 {
+  using store_type = typename ::std::aligned_storage<N>::type;
+
+  // moves must not throw, other functors spill
   template <typename U>
-  static R invoker_stub(void const* const ptr, A&&... args) noexcept(noexcept(
+  using is_inline = ::std::integral_constant<bool,
+    (sizeof(U) <= sizeof(store_type)) &&
+    (alignof(U) <= alignof(store_type)) &&
+    ::std::is_nothrow_move_constructible<U>{}
+  >;
+
+  // trivially copyable functors have no destroy, they are copied bytewise
+  struct ops_type
+  {
+    void (*destroy)(forwarder&);
+
+    void (*copy)(forwarder&, forwarder const&);
+    void (*move)(forwarder&, forwarder&);
+  };
+
+  template <typename U>
+  static R invoker_stub(void const* const ptr,
+    typename param_type<A>::type... args) noexcept(noexcept(
     (*static_cast<U const*>(ptr))(::std::forward<A>(args)...)))
   {
     return (*static_cast<U const*>(ptr))(::std::forward<A>(args)...);
   }
 
-  R (*stub_)(void const*, A&&...){};
+  template <typename U>
+  static R heap_invoker_stub(void const* const ptr,
+    typename param_type<A>::type... args) noexcept(noexcept(
+    (*static_cast<U const*>(ptr))(::std::forward<A>(args)...)))
+  {
+    return (**static_cast<U const* const*>(ptr))(
+      ::std::forward<A>(args)...);
+  }
+
+  R (*stub_)(void const*, typename param_type<A>::type...){};
+
+  ops_type const* ops_{};
 
-  typename ::std::aligned_storage<N>::type store_;
+  store_type store_;
 
 public:
   forwarder() = default;
 
-  forwarder(forwarder const&) = default;
+  forwarder(forwarder const& other) { copy(other); }
+
+  forwarder(forwarder&& other) noexcept { move(other); }
+
+  template <
+    typename T,
+    typename = typename ::std::enable_if<
+      !::std::is_same<forwarder, typename ::std::decay<T>::type>{}
+    >::type
+  >
+  forwarder(T&& f) { *this = ::std::forward<T>(f); }
+
+  ~forwarder() { reset(); }
+
+  forwarder& operator=(forwarder const& rhs)
+  {
+    if (this != &rhs)
+    {
+      reset();
+
+      copy(rhs);
+    }
+    // else do nothing
 
-  template<typename T> forwarder(T&& f) { *this = ::std::forward<T>(f); }
+    return *this;
+  }
 
-  forwarder& operator=(forwarder const&) = default;
+  forwarder& operator=(forwarder&& rhs) noexcept
+  {
+    if (this != &rhs)
+    {
+      reset();
 
-  forwarder& operator=(forwarder&&) = default;
+      move(rhs);
+    }
+    // else do nothing
+
+    return *this;
+  }
 
   template <
     typename T,
@@ -53,14 +125,13 @@ public:
   {
     using functor_type = typename ::std::decay<T>::type;
 
-    static_assert(sizeof(functor_type) <= sizeof(store_),
-      "functor too large");
-//  static_assert(::std::is_trivially_copyable<T>{},
-//    "functor not trivially copyable");
+    static_assert(S || is_inline<functor_type>{},
+      "functor too large or not nothrow move constructible");
 
-    new (static_cast<void*>(&store_)) functor_type(::std::forward<T>(f));
+    reset();
 
-    stub_ = invoker_stub<functor_type>;
+    construct<functor_type>(::std::forward<T>(f),
+      is_inline<functor_type>{});
 
     return *this;
   }
@@ -74,7 +145,158 @@ public:
     return stub_(&store_, ::std::forward<A>(args)...);
   }
 
-  void reset() noexcept { stub_ = nullptr; }
+  void reset() noexcept
+  {
+    if (ops_)
+    {
+      if (ops_->destroy)
+      {
+        ops_->destroy(*this);
+      }
+      // else do nothing
+
+      ops_ = {};
+    }
+    // else do nothing
+
+    stub_ = nullptr;
+  }
+
+private:
+  void copy(forwarder const& other)
+  {
+    if (other.ops_)
+    {
+      other.ops_->copy(*this, other);
+    }
+    // else do nothing
+
+    ops_ = other.ops_;
+    stub_ = other.stub_;
+  }
+
+  void move(forwarder& other) noexcept
+  {
+    auto const ops(other.ops_);
+    auto const stub(other.stub_);
+
+    if (ops)
+    {
+      ops->move(*this, other);
+    }
+    // else do nothing
+
+    ops_ = ops;
+    stub_ = stub;
+  }
+
+  template <typename U, typename T>
+  void construct(T&& f, ::std::true_type)
+  {
+    new (static_cast<void*>(&store_)) U(::std::forward<T>(f));
+
+    ops_ = ::std::is_trivially_copyable<U>{} ?
+      trivial_ops<U>() :
+      inline_ops<U>();
+    stub_ = invoker_stub<U>;
+  }
+
+  template <typename U, typename T>
+  void construct(T&& f, ::std::false_type)
+  {
+    static_assert(sizeof(U*) <= sizeof(store_type), "N is too small");
+
+    new (static_cast<void*>(&store_)) U*(new U(::std::forward<T>(f)));
+
+    ops_ = heap_ops<U>();
+    stub_ = heap_invoker_stub<U>;
+  }
+
+  template <typename U>
+  static ops_type const* inline_ops() noexcept
+  {
+    static constexpr ops_type const ops{
+      destroy_stub<U>, copy_stub<U>, move_stub<U>
+    };
+
+    return &ops;
+  }
+
+  template <typename U>
+  static ops_type const* trivial_ops() noexcept
+  {
+    static constexpr ops_type const ops{
+      nullptr, trivial_copy_stub<U>, trivial_move_stub<U>
+    };
+
+    return &ops;
+  }
+
+  template <typename U>
+  static ops_type const* heap_ops() noexcept
+  {
+    static constexpr ops_type const ops{
+      heap_destroy_stub<U>, heap_copy_stub<U>, heap_move_stub<U>
+    };
+
+    return &ops;
+  }
+
+  template <typename U>
+  static void destroy_stub(forwarder& f)
+  {
+    static_cast<U*>(static_cast<void*>(&f.store_))->~U();
+  }
+
+  template <typename U>
+  static void copy_stub(forwarder& dst, forwarder const& src)
+  {
+    new (static_cast<void*>(&dst.store_)) U(
+      *static_cast<U const*>(static_cast<void const*>(&src.store_)));
+  }
+
+  template <typename U>
+  static void move_stub(forwarder& dst, forwarder& src)
+  {
+    new (static_cast<void*>(&dst.store_)) U(
+      ::std::move(*static_cast<U*>(static_cast<void*>(&src.store_))));
+  }
+
+  // only the bytes of the functor, the rest of the store is uninitialized
+  template <typename U>
+  static void trivial_copy_stub(forwarder& dst, forwarder const& src)
+  {
+    ::std::memcpy(&dst.store_, &src.store_, sizeof(U));
+  }
+
+  template <typename U>
+  static void trivial_move_stub(forwarder& dst, forwarder& src)
+  {
+    ::std::memcpy(&dst.store_, &src.store_, sizeof(U));
+  }
+
+  template <typename U>
+  static void heap_destroy_stub(forwarder& f)
+  {
+    delete *static_cast<U**>(static_cast<void*>(&f.store_));
+  }
+
+  template <typename U>
+  static void heap_copy_stub(forwarder& dst, forwarder const& src)
+  {
+    new (static_cast<void*>(&dst.store_)) U*(new U(
+      **static_cast<U* const*>(static_cast<void const*>(&src.store_))));
+  }
+
+  template <typename U>
+  static void heap_move_stub(forwarder& dst, forwarder& src)
+  {
+    ::std::memcpy(&dst.store_, &src.store_, sizeof(U*));
+
+    // the heap functor changed owners
+    src.ops_ = {};
+    src.stub_ = nullptr;
+  }
 };
 
 }
@@ -0,0 +1,170 @@
+#ifndef FUNCTIONREF_HPP
+# define FUNCTIONREF_HPP
+# pragma once
+
+#include <cassert>
+
+#include <cstddef>
+
+#include <memory>
+
+#include <type_traits>
+
+#include <utility>
+
+#include "meta.hpp"
+
+namespace generic
+{
+
+// non-owning reference to a callable, the callable must outlive it; binding
+// a temporary is fine for the duration of the full expression, e.g. when
+// passing a lambda as an argument
+template <typename F> class function_ref;
+
+template <class R, class ...A>
+class function_ref<R (A...)>
+{
+  using function_ptr_type = R (*)(A...);
+
+  union any_ptr
+  {
+    void* object;
+    function_ptr_type function;
+  };
+
+  using stub_ptr_type = R (*)(any_ptr, typename param_type<A>::type...);
+
+  function_ref(void* const o, stub_ptr_type const m) noexcept :
+    stub_ptr_(m)
+  {
+    ptr_.object = o;
+  }
+
+public:
+  function_ref() = default;
+
+  function_ref(function_ref const&) = default;
+
+  function_ref(::std::nullptr_t const) noexcept : function_ref() { }
+
+  function_ref(function_ptr_type const function_ptr) noexcept :
+    stub_ptr_(function_ptr ? function_stub : nullptr)
+  {
+    ptr_.function = function_ptr;
+  }
+
+  template <
+    typename T,
+    typename = typename ::std::enable_if<
+      !::std::is_same<function_ref, typename ::std::decay<T>::type>{} &&
+      !::std::is_function<typename ::std::remove_reference<T>::type>{} &&
+      !::std::is_pointer<typename ::std::decay<T>::type>{}
+    >::type,
+    typename = decltype(::std::declval<T&>()(::std::declval<A>()...))
+  >
+  function_ref(T&& f) noexcept :
+    stub_ptr_(functor_stub<typename ::std::remove_reference<T>::type>)
+  {
+    ptr_.object = const_cast<void*>(static_cast<void const*>(
+      ::std::addressof(f)));
+  }
+
+  function_ref& operator=(function_ref const&) = default;
+
+  template <R (* const function_ptr)(A...)>
+  static function_ref from() noexcept
+  {
+    return { nullptr, static_function_stub<function_ptr> };
+  }
+
+  template <class C, R (C::* const method_ptr)(A...)>
+  static function_ref from(C* const object_ptr) noexcept
+  {
+    return { object_ptr, method_stub<C, method_ptr> };
+  }
+
+  template <class C, R (C::* const method_ptr)(A...) const>
+  static function_ref from(C const* const object_ptr) noexcept
+  {
+    return { const_cast<C*>(object_ptr), const_method_stub<C, method_ptr> };
+  }
+
+  template <class C, R (C::* const method_ptr)(A...)>
+  static function_ref from(C& object) noexcept
+  {
+    return { &object, method_stub<C, method_ptr> };
+  }
+
+  template <class C, R (C::* const method_ptr)(A...) const>
+  static function_ref from(C const& object) noexcept
+  {
+    return { const_cast<C*>(&object), const_method_stub<C, method_ptr> };
+  }
+
+  void reset() noexcept { stub_ptr_ = nullptr; }
+
+  void swap(function_ref& other) noexcept { ::std::swap(*this, other); }
+
+  bool operator==(::std::nullptr_t const) const noexcept
+  {
+    return !stub_ptr_;
+  }
+
+  bool operator!=(::std::nullptr_t const) const noexcept
+  {
+    return stub_ptr_;
+  }
+
+  explicit operator bool() const noexcept { return stub_ptr_; }
+
+  R operator()(A... args) const
+  {
+//  assert(stub_ptr_);
+    return stub_ptr_(ptr_, ::std::forward<A>(args)...);
+  }
+
+private:
+  any_ptr ptr_;
+  stub_ptr_type stub_ptr_{};
+
+  static R function_stub(any_ptr const p,
+    typename param_type<A>::type... args)
+  {
+    return p.function(::std::forward<A>(args)...);
+  }
+
+  template <R (*function_ptr)(A...)>
+  static R static_function_stub(any_ptr,
+    typename param_type<A>::type... args)
+  {
+    return function_ptr(::std::forward<A>(args)...);
+  }
+
+  template <class C, R (C::*method_ptr)(A...)>
+  static R method_stub(any_ptr const p,
+    typename param_type<A>::type... args)
+  {
+    return (static_cast<C*>(p.object)->*method_ptr)(
+      ::std::forward<A>(args)...);
+  }
+
+  template <class C, R (C::*method_ptr)(A...) const>
+  static R const_method_stub(any_ptr const p,
+    typename param_type<A>::type... args)
+  {
+    return (static_cast<C const*>(p.object)->*method_ptr)(
+      ::std::forward<A>(args)...);
+  }
+
+  template <typename T>
+  static R functor_stub(any_ptr const p,
+    typename param_type<A>::type... args)
+  {
+    return (*static_cast<T*>(p.object))(::std::forward<A>(args)...);
+  }
+};
+
+}
+
+#endif // FUNCTIONREF_HPP
@@ -0,0 +1,216 @@
+#ifndef INTRUSIVELIGHTPTR_HPP
+# define INTRUSIVELIGHTPTR_HPP
+# pragma once
+
+#include <cassert>
+
+#include <cstddef>
+
+#include <functional>
+
+#include <type_traits>
+
+#include <utility>
+
+#include "lightptr.hpp"
+
+namespace generic
+{
+
+// the reference count lives in the object, intrusive_light_ptr finds it
+// through the light_add_ref() and light_release() hooks by ADL; deriving
+// from light_ref_counted<T> provides both, the last release deletes a T, so
+// classes derived from T need a virtual destructor in T
+template <typename T, class P = atomic_counting>
+class light_ref_counted
+{
+  mutable P counter_{detail::counter_type{}};
+
+  friend void light_add_ref(light_ref_counted const* const p) noexcept
+  {
+    p->counter_.inc();
+  }
+
+  friend void light_release(light_ref_counted const* const p)
+  {
+    if (p->counter_.dec())
+    {
+      delete static_cast<T const*>(p);
+    }
+    // else do nothing
+  }
+
+protected:
+  light_ref_counted() = default;
+
+  // a copy is a new object, nobody refers to it yet
+  light_ref_counted(light_ref_counted const&) noexcept { }
+
+  ~light_ref_counted() = default;
+
+  light_ref_counted& operator=(light_ref_counted const&) noexcept
+  {
+    return *this;
+  }
+
+public:
+  detail::counter_type use_count() const noexcept { return counter_.get(); }
+};
+
+// one pointer wide; as the count travels with the object, a raw pointer,
+// e.g. this, can be turned into an owner at any time, except while the
+// object is being constructed
+template <typename T>
+class intrusive_light_ptr
+{
+  template <typename U> friend class intrusive_light_ptr;
+
+  T* ptr_{};
+
+public:
+  using element_type = T;
+
+  intrusive_light_ptr() = default;
+
+  intrusive_light_ptr(::std::nullptr_t const) noexcept { }
+
+  // if add_ref is false, adopts a reference, that is already held
+  explicit intrusive_light_ptr(T* const p, bool const add_ref = true)
+    noexcept :
+    ptr_(p)
+  {
+    if (ptr_ && add_ref)
+    {
+      light_add_ref(ptr_);
+    }
+    // else do nothing
+  }
+
+  intrusive_light_ptr(intrusive_light_ptr const& other) noexcept :
+    intrusive_light_ptr(other.ptr_)
+  {
+  }
+
+  intrusive_light_ptr(intrusive_light_ptr&& other) noexcept :
+    ptr_(other.ptr_)
+  {
+    other.ptr_ = nullptr;
+  }
+
+  template <typename U, typename =
+    typename ::std::enable_if<::std::is_convertible<U*, T*>{}>::type>
+  intrusive_light_ptr(intrusive_light_ptr<U> const& other) noexcept :
+    intrusive_light_ptr(other.ptr_)
+  {
+  }
+
+  template <typename U, typename =
+    typename ::std::enable_if<::std::is_convertible<U*, T*>{}>::type>
+  intrusive_light_ptr(intrusive_light_ptr<U>&& other) noexcept :
+    ptr_(other.ptr_)
+  {
+    other.ptr_ = nullptr;
+  }
+
+  ~intrusive_light_ptr()
+  {
+    if (ptr_)
+    {
+      light_release(ptr_);
+    }
+    // else do nothing
+  }
+
+  intrusive_light_ptr& operator=(intrusive_light_ptr const& rhs)
+  {
+    intrusive_light_ptr(rhs).swap(*this);
+
+    return *this;
+  }
+
+  intrusive_light_ptr& operator=(intrusive_light_ptr&& rhs) noexcept
+  {
+    intrusive_light_ptr(::std::move(rhs)).swap(*this);
+
+    return *this;
+  }
+
+  intrusive_light_ptr& operator=(::std::nullptr_t const)
+  {
+    reset();
+
+    return *this;
+  }
+
+  bool operator<(intrusive_light_ptr const& rhs) const noexcept
+  {
+    return ::std::less<T*>()(ptr_, rhs.ptr_);
+  }
+
+  bool operator==(intrusive_light_ptr const& rhs) const noexcept
+  {
+    return ptr_ == rhs.ptr_;
+  }
+
+  bool operator!=(intrusive_light_ptr const& rhs) const noexcept
+  {
+    return !operator==(rhs);
+  }
+
+  bool operator==(::std::nullptr_t const) const noexcept { return !ptr_; }
+
+  bool operator!=(::std::nullptr_t const) const noexcept { return ptr_; }
+
+  explicit operator bool() const noexcept { return ptr_; }
+
+  T& operator*() const noexcept { return *ptr_; }
+
+  T* operator->() const noexcept { return ptr_; }
+
+  T* get() const noexcept { return ptr_; }
+
+  void reset() { intrusive_light_ptr().swap(*this); }
+
+  void reset(T* const p, bool const add_ref = true)
+  {
+    intrusive_light_ptr(p, add_ref).swap(*this);
+  }
+
+  // gives up ownership without releasing the reference
+  T* detach() noexcept
+  {
+    auto const p(ptr_);
+
+    ptr_ = nullptr;
+
+    return p;
+  }
+
+  void swap(intrusive_light_ptr& other) noexcept
+  {
+    ::std::swap(ptr_, other.ptr_);
+  }
+};
+
+template<class T, class ...Args>
+inline intrusive_light_ptr<T> make_intrusive_light(Args&& ...args)
+{
+  return intrusive_light_ptr<T>(new T(::std::forward<Args>(args)...));
+}
+
+}
+
+namespace std
+{
+  template <typename T>
+  struct hash<::generic::intrusive_light_ptr<T> >
+  {
+    size_t operator()(::generic::intrusive_light_ptr<T> const& l) const
+      noexcept
+    {
+      return hash<T*>()(l.get());
+    }
+  };
+}
+
+#endif // INTRUSIVELIGHTPTR_HPP
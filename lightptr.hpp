@@ -4,14 +4,24 @@
 
 #include <cassert>
 
+#include <cstddef>
+
 #include <atomic>
 
 #include <memory>
 
+#include <new>
+
 #include <utility>
 
 #include <type_traits>
 
+#include "counterpool.hpp"
+
+#ifndef NDEBUG
+# include <thread>
+#endif
+
 namespace generic
 {
 
@@ -19,8 +29,6 @@ namespace detail
 {
   using counter_type = unsigned;
 
-  using atomic_type = ::std::atomic<counter_type>;
-
   template <typename T>
   using deleter_type = void (*)(T*);
 
@@ -35,9 +43,136 @@ namespace detail
   {
     using type = void;
   };
+
+  template <typename T, class P>
+  struct light_factory;
+
+  // the counting policy of the weak count
+  template <class P>
+  struct weak_counting
+  {
+    using type = P;
+  };
+
+  using release_type = void (*)(void*);
+
+  // policies, that may find the count dropped to zero later on, outside of
+  // dec(), provide bind(), they invoke release(object) at that time
+  template <class P>
+  inline auto bind_release(P& p, void* const object,
+    release_type const release, int) noexcept ->
+    decltype(p.bind(object, release))
+  {
+    return p.bind(object, release);
+  }
+
+  template <class P>
+  inline void bind_release(P&, void*, release_type, long) noexcept
+  {
+  }
 }
 
-template <typename T>
+// counting policies, a policy is the reference count itself
+class atomic_counting
+{
+  ::std::atomic<detail::counter_type> counter_;
+
+public:
+  explicit atomic_counting(detail::counter_type const c) noexcept :
+    counter_(c)
+  {
+  }
+
+  void inc() noexcept
+  {
+    counter_.fetch_add(detail::counter_type(1), ::std::memory_order_relaxed);
+  }
+
+  // returns true, if the last reference was dropped; the decrement
+  // releases the writes of this thread to whoever drops the last reference,
+  // that one acquires them before destroying the object
+  bool dec() noexcept
+  {
+    if (detail::counter_type(1) ==
+      counter_.fetch_sub(detail::counter_type(1),
+        ::std::memory_order_release))
+    {
+      ::std::atomic_thread_fence(::std::memory_order_acquire);
+
+      return true;
+    }
+    else
+    {
+      return false;
+    }
+  }
+
+  // returns false, if there were no references left
+  bool inc_if_nonzero() noexcept
+  {
+    auto c(counter_.load(::std::memory_order_relaxed));
+
+    do
+    {
+      if (!c)
+      {
+        return false;
+      }
+      // else do nothing
+    }
+    while (!counter_.compare_exchange_weak(c, c + 1,
+      ::std::memory_order_acq_rel, ::std::memory_order_relaxed));
+
+    return true;
+  }
+
+  detail::counter_type get() const noexcept
+  {
+    return counter_.load(::std::memory_order_relaxed);
+  }
+};
+
+// for objects, that never leave the creating thread; debug builds assert
+// this
+class plain_counting
+{
+  detail::counter_type counter_;
+
+#ifndef NDEBUG
+  ::std::thread::id const owner_{::std::this_thread::get_id()};
+#endif
+
+public:
+  explicit plain_counting(detail::counter_type const c) noexcept :
+    counter_(c)
+  {
+  }
+
+  void inc() noexcept
+  {
+    assert(::std::this_thread::get_id() == owner_);
+    ++counter_;
+  }
+
+  bool dec() noexcept
+  {
+    assert(::std::this_thread::get_id() == owner_);
+    return !--counter_;
+  }
+
+  bool inc_if_nonzero() noexcept
+  {
+    assert(::std::this_thread::get_id() == owner_);
+    return counter_ ? ++counter_ : false;
+  }
+
+  detail::counter_type get() const noexcept { return counter_; }
+};
+
+template <typename T, class P = atomic_counting>
+class light_weak_ptr;
+
+template <typename T, class P = atomic_counting>
 class light_ptr
 {
   template <typename U, typename V>
@@ -62,88 +197,337 @@ class light_ptr
 
   using deleter_type = detail::deleter_type<element_type>;
 
+  // the object is destroyed, when the last light_ptr is gone, the counter
+  // is freed, when the last light_weak_ptr is gone as well
   class counter_base
   {
     friend class light_ptr;
+    friend class light_weak_ptr<T, P>;
+
+    using invoker_type = void (*)(counter_base*);
+    using deallocator_type = void (*)(counter_base*);
 
-    using invoker_type = void (*)(counter_base*, element_type*);
+    P counter_;
 
-    detail::atomic_type counter_{};
+    // light_weak_ptrs + 1, while there are light_ptrs
+    typename detail::weak_counting<P>::type weak_counter_{
+      detail::counter_type(1)};
 
     invoker_type const invoker_;
+    deallocator_type const deallocator_;
+
+    static void release(void* const ptr)
+    {
+      auto const c(static_cast<counter_base*>(ptr));
+
+      c->invoker_(c);
+
+      c->dec_weak_ref();
+    }
 
   protected:
     explicit counter_base(detail::counter_type const c,
-      invoker_type const invoker) noexcept :
+      invoker_type const invoker,
+      deallocator_type const deallocator) :
       counter_(c),
-      invoker_(invoker)
+      invoker_(invoker),
+      deallocator_(deallocator)
     {
+      detail::bind_release(counter_, this, release, 0);
     }
 
   public:
     template <typename U>
     typename ::std::enable_if<!::std::is_void<U>{}>::type
-    dec_ref(U* const ptr)
+    dec_ref(U*)
     {
-      if (detail::counter_type(1) ==
-        counter_.fetch_sub(detail::counter_type(1),
-          ::std::memory_order_relaxed))
+      using type_must_be_complete = char[sizeof(U) ? 1 : -1];
+      (void)sizeof(type_must_be_complete);
+
+      if (counter_.dec())
       {
-        using type_must_be_complete = char[sizeof(U) ? 1 : -1];
-        (void)sizeof(type_must_be_complete);
-        invoker_(this, ptr);
+        release(this);
       }
       // else do nothing
     }
 
     template <typename U>
     typename ::std::enable_if<::std::is_void<U>{}>::type
-    dec_ref(U* const ptr)
+    dec_ref(U*)
     {
-      if (detail::counter_type(1) ==
-        counter_.fetch_sub(detail::counter_type(1),
-          ::std::memory_order_relaxed))
+      if (counter_.dec())
       {
-        invoker_(this, ptr);
+        release(this);
       }
       // else do nothing
     }
 
-    void inc_ref() noexcept
+    void inc_ref() noexcept { counter_.inc(); }
+
+    void dec_weak_ref()
     {
-      counter_.fetch_add(detail::counter_type(1),
-        ::std::memory_order_relaxed);
+      if (weak_counter_.dec())
+      {
+        deallocator_(this);
+      }
+      // else do nothing
     }
+
+    void inc_weak_ref() noexcept { weak_counter_.inc(); }
   };
 
   template <typename D>
   class counter : public counter_base
   {
+    element_type* const e_;
+
     typename ::std::decay<D>::type const d_;
 
   public:
-    explicit counter(detail::counter_type const c, D&& d) :
-      counter_base(c, invoker),
+    explicit counter(detail::counter_type const c, element_type* const e,
+      D&& d) :
+      counter_base(c, invoker, deallocator),
+      e_(e),
       d_(::std::forward<D>(d))
     {
     }
 
+    // counters are allocated at a high rate, they come from size class
+    // free lists, the blocks of which are aligned for max_align_t only
+    static void* operator new(::std::size_t const size)
+    {
+      static_assert(alignof(counter) <= alignof(::std::max_align_t),
+        "the deleter is over-aligned");
+
+      return detail::counter_pool<>::allocate(size);
+    }
+
+    static void operator delete(void* const p, ::std::size_t const size)
+      noexcept
+    {
+      detail::counter_pool<>::deallocate(p, size);
+    }
+
   private:
-    static void invoker(counter_base* const ptr, element_type* const e)
+    static void invoker(counter_base* const ptr)
     {
       auto const c(static_cast<counter<D>*>(ptr));
 
       // invoke deleter on the element
-      c->d_(e);
+      c->d_(c->e_);
+    }
 
+    static void deallocator(counter_base* const ptr)
+    {
       // delete from a static member function
-      delete c;
+      delete static_cast<counter<D>*>(ptr);
+    }
+  };
+
+  // the object lives in the same allocation as its counter
+  template <typename U>
+  class inplace_counter : public counter_base
+  {
+    typename ::std::aligned_storage<sizeof(U), alignof(U)>::type store_;
+
+  public:
+    template <typename ...A>
+    explicit inplace_counter(A&& ...args) :
+      counter_base(detail::counter_type(1), invoker, deallocator)
+    {
+      new (static_cast<void*>(&store_)) U(::std::forward<A>(args)...);
+    }
+
+    U* get() noexcept { return reinterpret_cast<U*>(&store_); }
+
+  private:
+    static void invoker(counter_base* const ptr)
+    {
+      static_cast<inplace_counter*>(ptr)->get()->~U();
+    }
+
+    static void deallocator(counter_base* const ptr)
+    {
+      delete static_cast<inplace_counter*>(ptr);
+    }
+  };
+
+  // like inplace_counter, but the counter and the object come from an
+  // allocator, a rebound copy of which lives in the counter
+  template <typename U, class A>
+  class allocator_counter : public counter_base
+  {
+    using allocator_type = typename ::std::allocator_traits<A>::template
+      rebind_alloc<allocator_counter>;
+
+    using traits_type = ::std::allocator_traits<allocator_type>;
+
+    using object_allocator_type = typename ::std::allocator_traits<A>::
+      template rebind_alloc<U>;
+
+    allocator_type a_;
+
+    typename ::std::aligned_storage<sizeof(U), alignof(U)>::type store_;
+
+    explicit allocator_counter(allocator_type const& a) :
+      counter_base(detail::counter_type(1), invoker, deallocator),
+      a_(a)
+    {
+    }
+
+  public:
+    template <typename ...B>
+    static allocator_counter* create(A const& alloc, B&& ...args)
+    {
+      allocator_type a(alloc);
+
+      auto const p(traits_type::allocate(a, 1));
+
+      allocator_counter* c;
+
+      try
+      {
+        c = new (static_cast<void*>(::std::addressof(*p)))
+          allocator_counter(a);
+      }
+      catch (...)
+      {
+        traits_type::deallocate(a, p, 1);
+
+        throw;
+      }
+
+      try
+      {
+        object_allocator_type oa(a);
+
+        ::std::allocator_traits<object_allocator_type>::construct(oa,
+          c->get(), ::std::forward<B>(args)...);
+      }
+      catch (...)
+      {
+        c->~allocator_counter();
+        traits_type::deallocate(a, p, 1);
+
+        throw;
+      }
+
+      return c;
+    }
+
+    U* get() noexcept { return reinterpret_cast<U*>(&store_); }
+
+  private:
+    static void invoker(counter_base* const ptr)
+    {
+      auto const c(static_cast<allocator_counter*>(ptr));
+
+      object_allocator_type oa(c->a_);
+
+      ::std::allocator_traits<object_allocator_type>::destroy(oa, c->get());
+    }
+
+    static void deallocator(counter_base* const ptr)
+    {
+      auto const c(static_cast<allocator_counter*>(ptr));
+
+      // the allocator must not free itself
+      allocator_type a(::std::move(c->a_));
+
+      c->~allocator_counter();
+
+      traits_type::deallocate(a, c, 1);
+    }
+  };
+
+  // the elements follow the counter in the same allocation
+  class array_counter : public counter_base
+  {
+    ::std::size_t const n_;
+
+    explicit array_counter(::std::size_t const n) noexcept :
+      counter_base(detail::counter_type(1), invoker, deallocator),
+      n_(n)
+    {
+    }
+
+  public:
+    static constexpr ::std::size_t offset() noexcept
+    {
+      return (sizeof(array_counter) + alignof(element_type) - 1) /
+        alignof(element_type) * alignof(element_type);
+    }
+
+    static array_counter* create(::std::size_t const n)
+    {
+      static_assert(alignof(element_type) <= alignof(::std::max_align_t),
+        "element_type is over-aligned");
+
+      auto const c(new (::operator new(offset() +
+        n * sizeof(element_type))) array_counter(n));
+
+      auto const p(c->get());
+
+      ::std::size_t i{};
+
+      try
+      {
+        for (; i != n; ++i)
+        {
+          new (static_cast<void*>(p + i)) element_type();
+        }
+      }
+      catch (...)
+      {
+        while (i)
+        {
+          p[--i].~element_type();
+        }
+
+        c->~array_counter();
+        ::operator delete(c);
+
+        throw;
+      }
+
+      return c;
+    }
+
+    element_type* get() noexcept
+    {
+      return reinterpret_cast<element_type*>(
+        reinterpret_cast<char*>(this) + offset());
+    }
+
+  private:
+    static void invoker(counter_base* const ptr)
+    {
+      auto const c(static_cast<array_counter*>(ptr));
+
+      auto const e(c->get());
+
+      for (auto i(c->n_); i;)
+      {
+        e[--i].~element_type();
+      }
+    }
+
+    static void deallocator(counter_base* const ptr)
+    {
+      auto const c(static_cast<array_counter*>(ptr));
+
+      c->~array_counter();
+      ::operator delete(c);
     }
   };
 
 private:
   template <typename U> friend struct ::std::hash;
 
+  friend struct detail::light_factory<T, P>;
+
+  friend class light_weak_ptr<T, P>;
+
   counter_base* counter_{};
 
   element_type* ptr_{};
@@ -201,6 +585,16 @@ public:
 
   light_ptr& operator=(light_ptr&& rhs) noexcept
   {
+    if (this == &rhs)
+    {
+      return *this;
+    }
+    else if (counter_)
+    {
+      counter_->dec_ref(ptr_);
+    }
+    // else do nothing
+
     counter_ = rhs.counter_;
     rhs.counter_ = nullptr;
 
@@ -284,7 +678,8 @@ public:
     }
     // else do nothing
 
-    counter_ = new counter<D>(detail::counter_type(1), ::std::forward<D>(d));
+    counter_ = new counter<D>(detail::counter_type(1), p,
+      ::std::forward<D>(d));
 
     ptr_ = p;
   }
@@ -303,28 +698,220 @@ public:
   detail::counter_type use_count() const noexcept
   {
     return counter_ ?
-      counter_->counter_.load(::std::memory_order_relaxed) :
+      counter_->counter_.get() :
+      detail::counter_type{};
+  }
+};
+
+// does not keep the object alive, only its counter; lock() yields a light_ptr
+// to the object, if it is still alive
+template <typename T, class P>
+class light_weak_ptr
+{
+  using counter_base = typename light_ptr<T, P>::counter_base;
+
+  using element_type = typename light_ptr<T, P>::element_type;
+
+  counter_base* counter_{};
+
+  element_type* ptr_{};
+
+public:
+  light_weak_ptr() = default;
+
+  light_weak_ptr(light_ptr<T, P> const& p) noexcept :
+    counter_(p.counter_),
+    ptr_(p.ptr_)
+  {
+    if (counter_)
+    {
+      counter_->inc_weak_ref();
+    }
+    // else do nothing
+  }
+
+  light_weak_ptr(light_weak_ptr const& other) noexcept :
+    counter_(other.counter_),
+    ptr_(other.ptr_)
+  {
+    if (counter_)
+    {
+      counter_->inc_weak_ref();
+    }
+    // else do nothing
+  }
+
+  light_weak_ptr(light_weak_ptr&& other) noexcept :
+    counter_(other.counter_),
+    ptr_(other.ptr_)
+  {
+    other.counter_ = nullptr;
+    other.ptr_ = nullptr;
+  }
+
+  ~light_weak_ptr()
+  {
+    if (counter_)
+    {
+      counter_->dec_weak_ref();
+    }
+    // else do nothing
+  }
+
+  light_weak_ptr& operator=(light_weak_ptr const& rhs)
+  {
+    light_weak_ptr(rhs).swap(*this);
+
+    return *this;
+  }
+
+  light_weak_ptr& operator=(light_weak_ptr&& rhs) noexcept
+  {
+    light_weak_ptr(::std::move(rhs)).swap(*this);
+
+    return *this;
+  }
+
+  light_weak_ptr& operator=(light_ptr<T, P> const& rhs)
+  {
+    light_weak_ptr(rhs).swap(*this);
+
+    return *this;
+  }
+
+  bool operator<(light_weak_ptr const& rhs) const noexcept
+  {
+    return counter_ < rhs.counter_;
+  }
+
+  bool expired() const noexcept { return !use_count(); }
+
+  light_ptr<T, P> lock() const noexcept
+  {
+    light_ptr<T, P> r;
+
+    if (counter_ && counter_->counter_.inc_if_nonzero())
+    {
+      r.counter_ = counter_;
+      r.ptr_ = ptr_;
+    }
+    // else do nothing
+
+    return r;
+  }
+
+  void reset() { light_weak_ptr().swap(*this); }
+
+  void swap(light_weak_ptr& other) noexcept
+  {
+    ::std::swap(counter_, other.counter_);
+    ::std::swap(ptr_, other.ptr_);
+  }
+
+  detail::counter_type use_count() const noexcept
+  {
+    return counter_ ?
+      counter_->counter_.get() :
       detail::counter_type{};
   }
 };
 
-template<class T, class ...Args>
-inline light_ptr<T> make_light(Args&& ...args)
+namespace detail
 {
-  return light_ptr<T>(new T(::std::forward<Args>(args)...));
+  template <typename T, class P>
+  struct light_factory
+  {
+    template <typename ...A>
+    static light_ptr<T, P> make(A&& ...args)
+    {
+      return adopt(new typename light_ptr<T, P>::template
+        inplace_counter<T>(::std::forward<A>(args)...));
+    }
+
+    static light_ptr<T, P> make_array(::std::size_t const n)
+    {
+      return adopt(light_ptr<T, P>::array_counter::create(n));
+    }
+
+    template <class A, typename ...B>
+    static light_ptr<T, P> allocate(A const& a, B&& ...args)
+    {
+      return adopt(light_ptr<T, P>::template
+        allocator_counter<T, A>::create(a, ::std::forward<B>(args)...));
+    }
+
+  private:
+    // adopts a counter, that already holds a reference
+    template <typename C>
+    static light_ptr<T, P> adopt(C* const c) noexcept
+    {
+      light_ptr<T, P> r;
+
+      r.counter_ = c;
+      r.ptr_ = c->get();
+
+      return r;
+    }
+  };
+
+  template <typename T, class P>
+  struct light_maker
+  {
+    template <typename ...A>
+    static light_ptr<T, P> make(A&& ...args)
+    {
+      return light_factory<T, P>::make(::std::forward<A>(args)...);
+    }
+  };
+
+  template <typename T, class P>
+  struct light_maker<T[], P>
+  {
+    static light_ptr<T[], P> make(::std::size_t const n)
+    {
+      return light_factory<T[], P>::make_array(n);
+    }
+  };
+
+  template <typename T, ::std::size_t N, class P>
+  struct light_maker<T[N], P>
+  {
+    static light_ptr<T[N], P> make()
+    {
+      return light_factory<T[N], P>::make_array(N);
+    }
+  };
+}
+
+// one allocation holds both the counter and the object; make_light<T[]>(n)
+// value-initializes n elements
+template<class T, class P = atomic_counting, class ...Args>
+inline light_ptr<T, P> make_light(Args&& ...args)
+{
+  return detail::light_maker<T, P>::make(::std::forward<Args>(args)...);
+}
+
+// like make_light, but the counter and the object are allocated through
+// alloc; a rebound copy of alloc frees them
+template<class T, class P = atomic_counting, class Alloc, class ...Args>
+inline light_ptr<T, P> allocate_light(Alloc const& alloc, Args&& ...args)
+{
+  static_assert(!::std::is_array<T>{}, "arrays are not supported");
+
+  return detail::light_factory<T, P>::allocate(alloc,
+    ::std::forward<Args>(args)...);
 }
 
 }
 
 namespace std
 {
-  template <typename T>
-  struct hash<::generic::light_ptr<T> >
+  template <typename T, class P>
+  struct hash<::generic::light_ptr<T, P> >
   {
-    size_t operator()(::generic::light_ptr<T> const& l) const noexcept
+    size_t operator()(::generic::light_ptr<T, P> const& l) const noexcept
     {
-      return hash<typename ::generic::light_ptr<T>::element_type*>()(
-        l.counter_);
+      return hash<void const*>()(l.counter_);
     }
   };
 }
@@ -0,0 +1,306 @@
+#ifndef MEMOIZED_HPP
+# define MEMOIZED_HPP
+# pragma once
+
+#include <cstddef>
+
+#include <cstdint>
+
+#include <atomic>
+
+#include <functional>
+
+#include <initializer_list>
+
+#include <memory>
+
+#include <mutex>
+
+#include <new>
+
+#include <tuple>
+
+#include <type_traits>
+
+#include <unordered_map>
+
+#include <utility>
+
+#include <vector>
+
+#include "basicdelegate.hpp"
+
+namespace generic
+{
+
+// caches results of a pure delegate; the cache is split into S shards, each
+// with its own lock and CLOCK (second chance) eviction
+template <typename D, ::std::size_t S = 16> class memoized;
+
+template <class R, class ...A, class T, ::std::size_t S>
+class memoized<basic_delegate<R (A...), T>, S>
+{
+  static_assert(S, "at least one shard is needed");
+  static_assert(!::std::is_void<R>{} && !::std::is_reference<R>{},
+    "R has to be a value type");
+
+  struct key_type
+  {
+    ::std::size_t hash;
+
+    ::std::tuple<typename ::std::decay<A>::type...> args;
+
+    bool operator==(key_type const& rhs) const
+    {
+      return (hash == rhs.hash) && (args == rhs.args);
+    }
+  };
+
+  struct key_hash
+  {
+    ::std::size_t operator()(key_type const& k) const noexcept
+    {
+      return k.hash;
+    }
+  };
+
+  struct entry
+  {
+    R value;
+
+    bool referenced;
+  };
+
+  using map_type = ::std::unordered_map<key_type, entry, key_hash>;
+
+  // a shard per cache line at least, the locks do not share lines
+  struct alignas(64) shard
+  {
+    ::std::mutex m_;
+
+    map_type map_;
+
+    ::std::vector<typename map_type::iterator> clock_;
+    ::std::size_t hand_{};
+
+    ::std::atomic<::std::size_t> hits_{};
+    ::std::atomic<::std::size_t> misses_{};
+  };
+
+  // new does not honour extended alignment before C++17, the shards are
+  // placed into an oversized buffer
+  class shard_array
+  {
+    ::std::unique_ptr<char[]> const buffer_;
+
+    shard* const shards_;
+
+  public:
+    shard_array() :
+      buffer_(new char[S * sizeof(shard) + alignof(shard) - 1]),
+      shards_(reinterpret_cast<shard*>(
+        (reinterpret_cast<::std::uintptr_t>(buffer_.get()) +
+          alignof(shard) - 1) & ~::std::uintptr_t(alignof(shard) - 1)))
+    {
+      ::std::size_t i{};
+
+      try
+      {
+        for (; i != S; ++i)
+        {
+          new (static_cast<void*>(shards_ + i)) shard;
+        }
+      }
+      catch (...)
+      {
+        while (i)
+        {
+          shards_[--i].~shard();
+        }
+
+        throw;
+      }
+    }
+
+    ~shard_array()
+    {
+      for (auto i(S); i;)
+      {
+        shards_[--i].~shard();
+      }
+    }
+
+    shard_array(shard_array const&) = delete;
+
+    shard_array& operator=(shard_array const&) = delete;
+
+    shard* get() const noexcept { return shards_; }
+
+    shard& operator[](::std::size_t const i) const noexcept
+    {
+      return shards_[i];
+    }
+  };
+
+public:
+  using delegate_type = basic_delegate<R (A...), T>;
+
+  // every shard holds one entry at least, even if capacity is 0
+  explicit memoized(delegate_type d, ::std::size_t const capacity = 1024) :
+    d_(::std::move(d)),
+    shard_capacity_(capacity ? (capacity + S - 1) / S : 1)
+  {
+    for (auto i(shards_.get()), end(i + S); i != end; ++i)
+    {
+      // no rehashing, the clock_ iterators stay valid
+      i->map_.reserve(shard_capacity_);
+      i->clock_.reserve(shard_capacity_);
+    }
+  }
+
+  R operator()(A... args) const
+  {
+    key_type k{hash(args...), ::std::tuple<
+      typename ::std::decay<A>::type...>(args...)};
+
+    auto& s(shards_[k.hash % S]);
+
+    {
+      ::std::lock_guard<::std::mutex> l(s.m_);
+
+      auto const i(s.map_.find(k));
+
+      if (s.map_.end() != i)
+      {
+        s.hits_.fetch_add(1, ::std::memory_order_relaxed);
+
+        i->second.referenced = true;
+
+        return i->second.value;
+      }
+      // else do nothing
+    }
+
+    // computed without the lock, a racing thread may compute it as well
+    R r(d_(::std::forward<A>(args)...));
+
+    ::std::lock_guard<::std::mutex> l(s.m_);
+
+    s.misses_.fetch_add(1, ::std::memory_order_relaxed);
+
+    if (s.map_.end() == s.map_.find(k))
+    {
+      insert(s, ::std::move(k), r);
+    }
+    // else do nothing
+
+    return r;
+  }
+
+  void clear()
+  {
+    for (auto i(shards_.get()), end(i + S); i != end; ++i)
+    {
+      ::std::lock_guard<::std::mutex> l(i->m_);
+
+      i->map_.clear();
+
+      i->clock_.clear();
+      i->hand_ = {};
+    }
+  }
+
+  ::std::size_t capacity() const noexcept { return shard_capacity_ * S; }
+
+  ::std::size_t size() const
+  {
+    ::std::size_t r{};
+
+    for (auto i(shards_.get()), end(i + S); i != end; ++i)
+    {
+      ::std::lock_guard<::std::mutex> l(i->m_);
+
+      r += i->map_.size();
+    }
+
+    return r;
+  }
+
+  ::std::size_t hits() const noexcept
+  {
+    ::std::size_t r{};
+
+    for (auto i(shards_.get()), end(i + S); i != end; ++i)
+    {
+      r += i->hits_.load(::std::memory_order_relaxed);
+    }
+
+    return r;
+  }
+
+  ::std::size_t misses() const noexcept
+  {
+    ::std::size_t r{};
+
+    for (auto i(shards_.get()), end(i + S); i != end; ++i)
+    {
+      r += i->misses_.load(::std::memory_order_relaxed);
+    }
+
+    return r;
+  }
+
+private:
+  delegate_type const d_;
+
+  ::std::size_t const shard_capacity_;
+
+  shard_array const shards_;
+
+  static ::std::size_t hash(A const& ...args)
+  {
+    ::std::size_t seed{};
+
+    (void)::std::initializer_list<int>{(seed ^=
+      ::std::hash<typename ::std::decay<A>::type>()(args) +
+        0x9e3779b9 + (seed << 6) + (seed >> 2), 0)...};
+
+    return seed;
+  }
+
+  void insert(shard& s, key_type&& k, R const& r) const
+  {
+    if (s.clock_.size() < shard_capacity_)
+    {
+      s.clock_.push_back(s.map_.emplace(::std::move(k),
+        entry{r, false}).first);
+    }
+    else
+    {
+      // give referenced entries a second chance
+      for (;; s.hand_ = (s.hand_ + 1) % shard_capacity_)
+      {
+        auto& i(s.clock_[s.hand_]);
+
+        if (i->second.referenced)
+        {
+          i->second.referenced = false;
+        }
+        else
+        {
+          s.map_.erase(i);
+
+          i = s.map_.emplace(::std::move(k), entry{r, false}).first;
+
+          s.hand_ = (s.hand_ + 1) % shard_capacity_;
+
+          break;
+        }
+      }
+    }
+  }
+};
+
+}
+
+#endif // MEMOIZED_HPP
@@ -47,6 +47,19 @@ struct all_of<A> : ::std::integral_constant<bool, A{}>
 {
 };
 
+// small trivially copyable arguments are cheaper to pass in registers, than
+// through a reference to a temporary
+template <typename T>
+struct param_type
+{
+  using type = typename ::std::conditional<
+    ::std::is_trivially_copyable<T>{} &&
+      (sizeof(T) <= 2 * sizeof(void*)),
+    T,
+    T&&
+  >::type;
+};
+
 }
 
 #endif // GENERIC_META_HPP
@@ -0,0 +1,575 @@
+#ifndef OBJECTPOOL_HPP
+# define OBJECTPOOL_HPP
+# pragma once
+
+#include <cassert>
+
+#include <cstddef>
+
+#include <cstdint>
+
+#include <algorithm>
+
+#include <atomic>
+
+#include <limits>
+
+#include <memory>
+
+#include <new>
+
+#include <type_traits>
+
+#include <utility>
+
+#include "lightptr.hpp"
+
+namespace generic
+{
+
+// hierarchical bitmap of N slots: a set bit in summary_ marks a full word
+template <::std::size_t N>
+class bitmap_slots
+{
+public:
+  using word_type = unsigned long long;
+
+  static constexpr auto const word_bits =
+    ::std::numeric_limits<word_type>::digits;
+
+  static constexpr auto const words = (N + word_bits - 1) / word_bits;
+
+  static_assert(N, "N has to be positive");
+  static_assert(words <= word_bits, "N too large");
+
+  static constexpr auto const full = ~word_type{};
+
+#ifdef __GNUC__
+  static int ffz(word_type const v) noexcept
+  {
+    return __builtin_ctzll(~v);
+  }
+#elif _MSC_VER && !__INTEL_COMPILER
+  static int ffz(word_type const v) noexcept
+  {
+    unsigned long r;
+
+    _BitScanForward64(&r, ~v);
+
+    return r;
+  }
+#elif __INTEL_COMPILER
+  static int ffz(word_type const v) noexcept
+  {
+    return _bit_scan_forward(~v);
+  }
+#else
+  static int ffz(word_type v) noexcept
+  {
+    int b{};
+
+    for (; (v & 1); ++b)
+    {
+      v >>= 1;
+    }
+
+    return b;
+  }
+#endif
+
+  bitmap_slots() noexcept
+  {
+    // bits past N are permanently claimed
+    for (::std::size_t i{}; i != words; ++i)
+    {
+      auto const first(i * word_bits);
+
+      words_[i].store(N >= first + word_bits ? word_type{} :
+        full << (N - first), ::std::memory_order_relaxed);
+    }
+
+    summary_.store(words == word_bits ? word_type{} : full << words,
+      ::std::memory_order_relaxed);
+  }
+
+  // returns a free slot or N, if there are none
+  ::std::size_t claim() noexcept
+  {
+    for (word_type s; full != (s = summary_.load());)
+    {
+      auto const w(ffz(s));
+
+      for (auto m(words_[w].load(::std::memory_order_relaxed));
+        full != m;)
+      {
+        auto const i(ffz(m));
+        auto const bit(word_type(1) << i);
+
+        if (!((m = words_[w].fetch_or(bit, ::std::memory_order_acquire)) &
+          bit))
+        {
+          if (full == (m | bit))
+          {
+            mark_full(w);
+          }
+          // else do nothing
+
+          return w * word_bits + i;
+        }
+        // else do nothing
+      }
+
+      mark_full(w);
+    }
+
+    return N;
+  }
+
+  // claims up to n free slots, one fetch_or per word; returns the count
+  ::std::size_t claim(::std::size_t* const out, ::std::size_t const n)
+    noexcept
+  {
+    ::std::size_t r{};
+
+    for (word_type s; (n != r) && (full != (s = summary_.load()));)
+    {
+      auto const w(ffz(s));
+
+      auto const m(words_[w].load(::std::memory_order_relaxed));
+
+      word_type want{};
+
+      for (auto i(r); (n != i) && (full != (m | want)); ++i)
+      {
+        want |= word_type(1) << ffz(m | want);
+      }
+
+      auto const prev(words_[w].fetch_or(want,
+        ::std::memory_order_acquire));
+
+      for (auto got(want & ~prev); got; got &= got - 1)
+      {
+        out[r++] = w * word_bits + ffz(~got);
+      }
+
+      if (full == (prev | want))
+      {
+        mark_full(w);
+      }
+      // else do nothing
+    }
+
+    return r;
+  }
+
+  void release(::std::size_t const i) noexcept
+  {
+    auto const w(i / word_bits);
+
+    if (full == words_[w].fetch_and(~(word_type(1) << (i % word_bits))))
+    {
+      summary_.fetch_and(~(word_type(1) << w));
+    }
+    // else do nothing
+  }
+
+private:
+  void mark_full(::std::size_t const w) noexcept
+  {
+    summary_.fetch_or(word_type(1) << w);
+
+    // a slot may have been released in the meantime
+    if (full != words_[w].load())
+    {
+      summary_.fetch_and(~(word_type(1) << w));
+    }
+    // else do nothing
+  }
+
+  ::std::atomic<word_type> summary_;
+
+  ::std::atomic<word_type> words_[words];
+};
+
+// lock-free free list of N slots, the head carries a tag against ABA
+template <::std::size_t N>
+class free_list_slots
+{
+  static_assert(N, "N has to be positive");
+  static_assert(N < ::std::numeric_limits<::std::uint32_t>::max(),
+    "N too large");
+
+  using head_type = ::std::uint64_t;
+
+  static constexpr ::std::size_t index(head_type const h) noexcept
+  {
+    return h & ::std::numeric_limits<::std::uint32_t>::max();
+  }
+
+  static constexpr head_type make_head(::std::size_t const i,
+    head_type const h) noexcept
+  {
+    return ((h >> 32) + 1) << 32 | i;
+  }
+
+public:
+  free_list_slots() noexcept
+  {
+    for (::std::size_t i{}; i != N; ++i)
+    {
+      next_[i].store(i + 1, ::std::memory_order_relaxed);
+    }
+
+    head_.store(head_type{}, ::std::memory_order_relaxed);
+  }
+
+  // returns a free slot or N, if there are none
+  ::std::size_t claim() noexcept
+  {
+    for (auto h(head_.load(::std::memory_order_acquire));;)
+    {
+      auto const i(index(h));
+
+      if (N == i)
+      {
+        return N;
+      }
+      else if (head_.compare_exchange_weak(h,
+        make_head(next_[i].load(::std::memory_order_relaxed), h),
+        ::std::memory_order_acquire, ::std::memory_order_acquire))
+      {
+        return i;
+      }
+      // else do nothing
+    }
+  }
+
+  ::std::size_t claim(::std::size_t* const out, ::std::size_t const n)
+    noexcept
+  {
+    ::std::size_t r{};
+
+    for (::std::size_t i; (n != r) && (N != (i = claim()));)
+    {
+      out[r++] = i;
+    }
+
+    return r;
+  }
+
+  void release(::std::size_t const i) noexcept
+  {
+    auto h(head_.load(::std::memory_order_relaxed));
+
+    do
+    {
+      next_[i].store(index(h), ::std::memory_order_relaxed);
+    }
+    while (!head_.compare_exchange_weak(h, make_head(i, h),
+      ::std::memory_order_release, ::std::memory_order_relaxed));
+  }
+
+private:
+  ::std::atomic<head_type> head_;
+
+  ::std::atomic<::std::uint32_t> next_[N];
+};
+
+namespace detail
+{
+
+template <bool>
+class pool_counters
+{
+public:
+  void allocated(::std::size_t const n) noexcept
+  {
+    allocations_.fetch_add(n, ::std::memory_order_relaxed);
+
+    auto const size(size_.fetch_add(n, ::std::memory_order_relaxed) + n);
+
+    for (auto peak(peak_.load(::std::memory_order_relaxed));
+      (peak < size) && !peak_.compare_exchange_weak(peak, size,
+        ::std::memory_order_relaxed););
+  }
+
+  void deallocated() noexcept
+  {
+    size_.fetch_sub(1, ::std::memory_order_relaxed);
+  }
+
+  void fell_back() noexcept
+  {
+    fallbacks_.fetch_add(1, ::std::memory_order_relaxed);
+  }
+
+  ::std::size_t allocations() const noexcept
+  {
+    return allocations_.load(::std::memory_order_relaxed);
+  }
+
+  ::std::size_t fallbacks() const noexcept
+  {
+    return fallbacks_.load(::std::memory_order_relaxed);
+  }
+
+  ::std::size_t size() const noexcept
+  {
+    return size_.load(::std::memory_order_relaxed);
+  }
+
+  ::std::size_t peak_size() const noexcept
+  {
+    return peak_.load(::std::memory_order_relaxed);
+  }
+
+private:
+  ::std::atomic<::std::size_t> allocations_{};
+  ::std::atomic<::std::size_t> fallbacks_{};
+
+  ::std::atomic<::std::size_t> size_{};
+  ::std::atomic<::std::size_t> peak_{};
+};
+
+template <>
+class pool_counters<false>
+{
+public:
+  void allocated(::std::size_t) noexcept { }
+
+  void deallocated() noexcept { }
+
+  void fell_back() noexcept { }
+
+  ::std::size_t allocations() const noexcept { return {}; }
+
+  ::std::size_t fallbacks() const noexcept { return {}; }
+
+  ::std::size_t size() const noexcept { return {}; }
+
+  ::std::size_t peak_size() const noexcept { return {}; }
+};
+
+}
+
+// a pool of N slots per slab, up to G slabs are allocated on demand, after
+// the first one fills up; when all are full, create() falls back to new T
+//
+// S selects the slot allocation (bitmap_slots or free_list_slots), C turns
+// the occupancy and fallback counters on or off
+template <typename T, ::std::size_t N = 64, ::std::size_t G = 15,
+  template <::std::size_t> class S = bitmap_slots, bool C = true>
+class object_pool
+{
+  using storage_type =
+    typename ::std::aligned_storage<sizeof(T), alignof(T)>::type;
+
+  struct slab
+  {
+    S<N> slots_;
+
+    storage_type store_[N];
+
+    bool contains(void const* const p) const noexcept
+    {
+      return (p >= static_cast<void const*>(store_)) &&
+        (p < static_cast<void const*>(store_ + N));
+    }
+
+    ::std::size_t index(void const* const p) const noexcept
+    {
+      return static_cast<storage_type const*>(p) - store_;
+    }
+  };
+
+public:
+  using value_type = T;
+
+  static constexpr auto const slab_size = N;
+
+  static constexpr auto const max_slabs = G + 1;
+
+  constexpr object_pool() noexcept { }
+
+  ~object_pool()
+  {
+    for (auto& s: slabs_)
+    {
+      delete s.load(::std::memory_order_relaxed);
+    }
+  }
+
+  object_pool(object_pool const&) = delete;
+
+  object_pool& operator=(object_pool const&) = delete;
+
+  // raw slot or nullptr, if all slabs are full
+  void* allocate()
+  {
+    for (::std::size_t i{}; i != max_slabs; ++i)
+    {
+      auto const s(get_slab(i));
+
+      auto const j(s->slots_.claim());
+
+      if (N != j)
+      {
+        counters_.allocated(1);
+
+        return &s->store_[j];
+      }
+      // else do nothing
+    }
+
+    return nullptr;
+  }
+
+  // claims up to n raw slots, returns the count
+  ::std::size_t allocate(void** const out, ::std::size_t const n)
+  {
+    ::std::size_t r{};
+
+    ::std::size_t slots[64];
+
+    for (::std::size_t i{}; (n != r) && (i != max_slabs); ++i)
+    {
+      auto const s(get_slab(i));
+
+      for (::std::size_t j; (n != r) && (j = s->slots_.claim(slots,
+        ::std::min(n - r, sizeof(slots) / sizeof(*slots))));)
+      {
+        while (j)
+        {
+          out[r++] = &s->store_[slots[--j]];
+        }
+      }
+    }
+
+    counters_.allocated(r);
+
+    return r;
+  }
+
+  // p has to be owned by the pool
+  void deallocate(void* const p) noexcept
+  {
+    auto const s(find(p));
+    assert(s);
+
+    counters_.deallocated();
+
+    s->slots_.release(s->index(p));
+  }
+
+  bool owns(void const* const p) const noexcept { return find(p); }
+
+  template <typename ...A>
+  T* create(A&& ...args)
+  {
+    if (auto const p = allocate())
+    {
+      try
+      {
+        return new (p) T(::std::forward<A>(args)...);
+      }
+      catch (...)
+      {
+        deallocate(p);
+
+        throw;
+      }
+    }
+    else
+    {
+      counters_.fell_back();
+
+      return new T(::std::forward<A>(args)...);
+    }
+  }
+
+  void destroy(T* const p) noexcept
+  {
+    if (auto const s = find(p))
+    {
+      p->~T();
+
+      // the slot is released after the destructor finishes
+      counters_.deallocated();
+
+      s->slots_.release(s->index(p));
+    }
+    else
+    {
+      delete p;
+    }
+  }
+
+  // the pool has to outlive the returned pointer
+  template <typename ...A>
+  light_ptr<T> make_light(A&& ...args)
+  {
+    return light_ptr<T>(create(::std::forward<A>(args)...),
+      [this](T* const p) noexcept { destroy(p); });
+  }
+
+  static constexpr ::std::size_t capacity() noexcept
+  {
+    return max_slabs * N;
+  }
+
+  ::std::size_t allocations() const noexcept
+  {
+    return counters_.allocations();
+  }
+
+  ::std::size_t fallbacks() const noexcept { return counters_.fallbacks(); }
+
+  ::std::size_t size() const noexcept { return counters_.size(); }
+
+  ::std::size_t peak_size() const noexcept { return counters_.peak_size(); }
+
+private:
+  ::std::atomic<slab*> slabs_[max_slabs]{};
+
+  detail::pool_counters<C> counters_;
+
+  slab* get_slab(::std::size_t const i)
+  {
+    auto s(slabs_[i].load(::std::memory_order_acquire));
+
+    if (!s)
+    {
+      ::std::unique_ptr<slab> n(new slab);
+
+      if (slabs_[i].compare_exchange_strong(s, n.get(),
+        ::std::memory_order_acq_rel, ::std::memory_order_acquire))
+      {
+        s = n.release();
+      }
+      // else do nothing
+    }
+    // else do nothing
+
+    return s;
+  }
+
+  slab* find(void const* const p) const noexcept
+  {
+    for (auto& sp: slabs_)
+    {
+      auto const s(sp.load(::std::memory_order_acquire));
+
+      if (!s || s->contains(p))
+      {
+        return s;
+      }
+      // else do nothing
+    }
+
+    return nullptr;
+  }
+};
+
+}
+
+#endif // OBJECTPOOL_HPP
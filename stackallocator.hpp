@@ -6,10 +6,20 @@
 
 #include <cstddef>
 
+#include <functional>
+
+#include <map>
+
 #include <new>
 
+#include <string>
+
+#include <unordered_map>
+
 #include <utility>
 
+#include <vector>
+
 namespace generic
 {
 
@@ -69,7 +79,7 @@ public:
 
   ::std::size_t used() const noexcept
   {
-    return ::std::size_t(ptr_ - reinterpret_cast<char*>(&buf_));
+    return ::std::size_t(ptr_ - reinterpret_cast<char const*>(&buf_));
   }
 
 private:
@@ -166,24 +176,6 @@ private:
 
 }
 
-namespace std
-{
-  // map
-  template<class Key, class T, class Compare, class Allocator> class map;
-
-  // string
-  template<class CharT> struct char_traits;
-
-  template<class CharT, class Traits, class Allocator> class basic_string;
-
-  // unordered_map
-  template<class Key, class T, class Hash, class Pred, class Alloc>
-    class unordered_map;
-
-  // vector
-  template <class T, class Alloc> class vector;
-}
-
 template <class Key, class T, class Compare = ::std::less<Key> >
 using stack_map = ::std::map<Key, T, Compare,
   ::generic::stack_allocator<::std::pair<Key const, T>, 256> >;
@@ -4,493 +4,363 @@
 
 #include <cassert>
 
-#include <cstdlib>
-
-#include <atomic>
+#include <cstddef>
 
-#include <limits>
+#include <cstdlib>
 
 #include <memory>
 
+#include <mutex>
+
 #include <new>
 
-#include <thread>
+#include <ostream>
+
+#include <string>
 
 #include <type_traits>
 
-#include <utility>
+#include <typeinfo>
 
-#include "lightptr.hpp"
+#include <utility>
 
-namespace
-{
-  template <typename T, typename A = unsigned short>
-  struct static_store
-  {
-    static_assert(::std::is_unsigned<A>{}, "A has to be unsigned");
+#include <vector>
 
-    using memory_map_type = A;
+#ifdef __GNUC__
+# include <cxxabi.h>
+#endif // __GNUC__
 
-    static constexpr auto const max_instances =
-      ::std::numeric_limits<unsigned char>::digits * sizeof(A);
+#include "basicdelegate.hpp"
 
-    static void cleanup() { delete [] store_; }
+#include "lightptr.hpp"
 
-#ifdef __GNUC__
-    static int ffz(unsigned long long const v)
-    {
-      return __builtin_ctzll(~v);
-    }
+#include "objectpool.hpp"
 
-    static int ffz(unsigned long const v)
-    {
-      return __builtin_ctzl(~v);
-    }
+namespace generic
+{
 
-    template <typename U>
-    static int ffz(U const v)
-    {
-      return __builtin_ctz(~v);
-    }
+namespace detail
+{
 
-#elif _MSC_VER && !__INTEL_COMPILER
-    template <typename U>
-    static int ffz(U const v)
-    {
-      return ::std::numeric_limits<unsigned char>::digits * sizeof(v) -
-        __lzcnt64(v & -v);
-    }
-#elif __INTEL_COMPILER
-    template <typename U>
-    static int ffz(U const v)
-    {
-      return _bit_scan_forward(~v);
-    }
-#else
-    template <typename U>
-    static int ffz(U v)
-    {
-      decltype(ffz()) b{};
+struct static_store_stats
+{
+  ::std::string type;
 
-      for (; (v & 1); ++b)
-      {
-        v >>= 1;
-      }
+  ::std::size_t slab_size;
+  ::std::size_t max_slabs;
+  ::std::size_t magazine_size;
 
-      return b;
-    }
-#endif
+  ::std::size_t capacity;
 
-    static ::std::atomic_flag lock_;
+  ::std::size_t allocations;
+  ::std::size_t fallbacks;
 
-    static memory_map_type memory_map_;
+  ::std::size_t size;
+  ::std::size_t peak_size;
+};
 
-    static typename ::std::aligned_storage<sizeof(T),
-      alignof(T)>::type* store_;
-  };
+// every static_store instantiation with STATICDELEGATE_STATS defined
+class static_store_registry
+{
+public:
+  using getter_type = static_store_stats (*)();
 
-  template <typename T, typename A>
-  ::std::atomic_flag static_store<T, A>::lock_;
+  static bool add(getter_type const g)
+  {
+    ::std::lock_guard<::std::mutex> l(mutex());
 
-  template <typename T, typename A>
-  A static_store<T, A>::memory_map_;
+    getters().push_back(g);
 
-  template <typename T, typename A>
-  typename ::std::aligned_storage<sizeof(T), alignof(T)>::type*
-    static_store<T, A>::store_{(::std::atexit(static_store<T, A>::cleanup),
-      new typename ::std::aligned_storage<sizeof(T),
-        alignof(T)>::type[static_store<T, A>::max_instances])};
+    return true;
+  }
 
-  template <typename T, typename ...A>
-  inline T* static_new(A&& ...args)
+  static ::std::vector<static_store_stats> stats()
   {
-    using static_store = static_store<T>;
+    ::std::vector<static_store_stats> r;
 
-    while (static_store::lock_.test_and_set(::std::memory_order_acquire))
-    {
-      ::std::this_thread::yield();
-    }
+    ::std::lock_guard<::std::mutex> l(mutex());
 
-    if (::std::numeric_limits<decltype(static_store::memory_map_)>::max() ==
-      static_store::memory_map_)
+    for (auto const g: getters())
     {
-      static_store::lock_.clear(::std::memory_order_release);
-
-      return new T(::std::forward<A>(args)...);
+      r.push_back(g());
     }
-    else
-    {
-      auto const i(static_store::ffz(static_store::memory_map_));
 
-      auto p(new (&static_store::store_[i]) T(::std::forward<A>(args)...));
-
-      static_store::memory_map_ |=
-        typename static_store::memory_map_type(1) << i;
+    return r;
+  }
 
-      static_store::lock_.clear(::std::memory_order_release);
+private:
+  static ::std::mutex& mutex()
+  {
+    static ::std::mutex m;
 
-      return p;
-    }
+    return m;
   }
 
-  template <typename T>
-  inline void static_delete(T* const p)
+  static ::std::vector<getter_type>& getters()
   {
-    using static_store = static_store<T>;
+    static ::std::vector<getter_type> g;
 
-    if ((static_cast<char*>(static_cast<void*>(p)) >=
-      static_cast<char*>(static_cast<void*>(static_store::store_))) &&
-      (static_cast<char*>(static_cast<void*>(static_store::store_)) +
-        static_store::max_instances * sizeof(T) >
-      static_cast<char*>(static_cast<void*>(p))))
-    {
-      auto const i(p - static_cast<T*>(static_cast<void*>(
-        static_store::store_)));
-      //assert(!as_const(static_store::memory_map_)[i]);
+    return g;
+  }
+};
 
-      while (static_store::lock_.test_and_set(::std::memory_order_acquire))
-      {
-        ::std::this_thread::yield();
-      }
+template <typename T>
+inline ::std::string type_name()
+{
+#ifdef __GNUC__
+  int status;
 
-      static_store::memory_map_ &=
-        ~(typename static_store::memory_map_type(1) << i);
+  ::std::unique_ptr<char, void (*)(void*)> const n(
+    ::abi::__cxa_demangle(typeid(T).name(), nullptr, nullptr, &status),
+    ::std::free);
 
-      static_cast<T*>(static_cast<void*>(&static_store::store_[i]))->~T();
+  return n ? n.get() : typeid(T).name();
+#else
+  return typeid(T).name();
+#endif // __GNUC__
+}
 
-      static_store::lock_.clear(::std::memory_order_release);
-    }
-    else
-    {
-      delete p;
-    }
-  }
 }
 
-namespace generic
+inline ::std::vector<detail::static_store_stats> staticdelegate_stats()
 {
+  return detail::static_store_registry::stats();
+}
 
-template <typename T> class staticdelegate;
-
-template<class R, class ...A>
-class staticdelegate<R (A...)>
+inline void dump_staticdelegate_stats(::std::ostream& os)
 {
-  using stub_ptr_type = R (*)(void*, A&&...);
-
-  staticdelegate(void* const o, stub_ptr_type const m) noexcept :
-    object_ptr_(o),
-    stub_ptr_(m)
+  for (auto& s: staticdelegate_stats())
   {
+    os << s.type << ": capacity " << s.capacity <<
+      " (" << s.max_slabs << " x " << s.slab_size <<
+      ", magazine " << s.magazine_size << "), allocations " <<
+      s.allocations << ", fallbacks " << s.fallbacks <<
+      ", size " << s.size << ", peak " << s.peak_size << '\n';
   }
+}
 
-public:
-  staticdelegate() = default;
-
-  staticdelegate(staticdelegate const&) = default;
-
-  staticdelegate(staticdelegate&&) = default;
-
-  staticdelegate(::std::nullptr_t const) noexcept : staticdelegate() { }
+}
 
-  template <class C, typename =
-    typename ::std::enable_if< ::std::is_class<C>{}>::type>
-  explicit staticdelegate(C const* const o) noexcept :
-    object_ptr_(const_cast<C*>(o))
+namespace
+{
+  // object_pool per functor type; with M set, each thread caches up to M
+  // claimed slots, a slot freed on another thread simply joins that
+  // thread's cache
+  template <typename T, ::std::size_t N = 16, ::std::size_t G = 0,
+    ::std::size_t M = 0>
+  struct static_store
   {
-  }
+#ifdef STATICDELEGATE_STATS
+    using pool_type = ::generic::object_pool<T, N, G,
+      ::generic::bitmap_slots, true>;
+#else
+    using pool_type = ::generic::object_pool<T, N, G,
+      ::generic::bitmap_slots, false>;
+#endif // STATICDELEGATE_STATS
 
-  template <class C, typename =
-    typename ::std::enable_if< ::std::is_class<C>{}>::type>
-  explicit staticdelegate(C const& o) noexcept :
-    object_ptr_(const_cast<C*>(&o))
-  {
-  }
+    static constexpr auto const max_instances = N;
 
-  template <class C>
-  staticdelegate(C* const object_ptr, R (C::* const method_ptr)(A...))
-  {
-    *this = from(object_ptr, method_ptr);
-  }
+    struct magazine
+    {
+      void* slots_[M ? M : 1];
 
-  template <class C>
-  staticdelegate(C* const object_ptr, R (C::* const method_ptr)(A...) const)
-  {
-    *this = from(object_ptr, method_ptr);
-  }
+      ::std::size_t size_;
 
-  template <class C>
-  staticdelegate(C& object, R (C::* const method_ptr)(A...))
-  {
-    *this = from(object, method_ptr);
-  }
+      bool dead_;
+    };
 
-  template <class C>
-  staticdelegate(C const& object, R (C::* const method_ptr)(A...) const)
-  {
-    *this = from(object, method_ptr);
-  }
+    struct magazine_flusher
+    {
+      ~magazine_flusher()
+      {
+        auto& m(cache());
 
-  template <
-    typename T,
-    typename = typename ::std::enable_if<
-      !::std::is_same<staticdelegate, typename ::std::decay<T>::type>{}
-    >::type
-  >
-  staticdelegate(T&& f) :
-    store_(static_new<typename ::std::decay<T>::type>(::std::forward<T>(f)),
-      functor_deleter<typename ::std::decay<T>::type>)
-  {
-    using functor_type = typename ::std::decay<T>::type;
+        flush(m, m.size_);
 
-    object_ptr_ = store_.get();
+        m.dead_ = true;
+      }
+    };
 
-    stub_ptr_ = functor_stub<functor_type>;
-  }
+    static magazine& cache() noexcept
+    {
+      static thread_local magazine m;
 
-  staticdelegate& operator=(staticdelegate const&) = default;
+      return m;
+    }
 
-  staticdelegate& operator=(staticdelegate&&) = default;
+    // nullptr once the thread's cache has been flushed on thread exit
+    static magazine* local()
+    {
+      static thread_local magazine_flusher const f;
+      (void)f;
 
-  template <class C>
-  staticdelegate& operator=(R (C::* const rhs)(A...))
-  {
-    return *this = from(static_cast<C*>(object_ptr_), rhs);
-  }
+      auto& m(cache());
 
-  template <class C>
-  staticdelegate& operator=(R (C::* const rhs)(A...) const)
-  {
-    return *this = from(static_cast<C const*>(object_ptr_), rhs);
-  }
+      return m.dead_ ? nullptr : &m;
+    }
 
-  template <
-    typename T,
-    typename = typename ::std::enable_if<
-      !::std::is_same<staticdelegate, typename ::std::decay<T>::type>{}
-    >::type
-  >
-  staticdelegate& operator=(T&& f)
-  {
-    using functor_type = typename ::std::decay<T>::type;
+    static void refill(magazine& m)
+    {
+      m.size_ += pool_.allocate(m.slots_ + m.size_, (M + 1) / 2 - m.size_);
+    }
 
-    store_.reset(static_new<functor_type>(::std::forward<T>(f)),
-      functor_deleter<functor_type>);
+    static void flush(magazine& m, ::std::size_t n) noexcept
+    {
+      for (; n; --n)
+      {
+        pool_.deallocate(m.slots_[--m.size_]);
+      }
+    }
 
-    object_ptr_ = store_.get();
+#ifdef STATICDELEGATE_STATS
+    // with magazines, allocations count slots moved into them
+    static ::generic::detail::static_store_stats stats()
+    {
+      return {
+        ::generic::detail::type_name<T>(),
+        N, G + 1, M,
+        pool_.capacity(),
+        pool_.allocations(), pool_.fallbacks(),
+        pool_.size(), pool_.peak_size()
+      };
+    }
 
-    stub_ptr_ = functor_stub<functor_type>;
+    static bool const registered_;
+#endif // STATICDELEGATE_STATS
 
-    return *this;
-  }
+    static pool_type pool_;
+  };
 
-  template <R (* const function_ptr)(A...)>
-  static staticdelegate from() noexcept
-  {
-    return { nullptr, function_stub<function_ptr> };
-  }
+  template <typename T, ::std::size_t N, ::std::size_t G, ::std::size_t M>
+  typename static_store<T, N, G, M>::pool_type static_store<T, N, G, M>::pool_;
 
-  template <class C, R (C::* const method_ptr)(A...)>
-  static staticdelegate from(C* const object_ptr) noexcept
-  {
-    return { object_ptr, method_stub<C, method_ptr> };
-  }
+#ifdef STATICDELEGATE_STATS
+  template <typename T, ::std::size_t N, ::std::size_t G, ::std::size_t M>
+  bool const static_store<T, N, G, M>::registered_{
+    ::generic::detail::static_store_registry::add(
+      static_store<T, N, G, M>::stats)};
+#endif // STATICDELEGATE_STATS
 
-  template <class C, R (C::* const method_ptr)(A...) const>
-  static staticdelegate from(C const* const object_ptr) noexcept
+  template <typename T, ::std::size_t N = 16, ::std::size_t G = 0,
+    ::std::size_t M = 0, typename ...A>
+  inline T* static_new(A&& ...args)
   {
-    return { const_cast<C*>(object_ptr), const_method_stub<C, method_ptr> };
-  }
+    using static_store = static_store<T, N, G, M>;
 
-  template <class C, R (C::* const method_ptr)(A...)>
-  static staticdelegate from(C& object) noexcept
-  {
-    return { &object, method_stub<C, method_ptr> };
-  }
+#ifdef STATICDELEGATE_STATS
+    (void)static_store::registered_;
+#endif // STATICDELEGATE_STATS
 
-  template <class C, R (C::* const method_ptr)(A...) const>
-  static staticdelegate from(C const& object) noexcept
-  {
-    return { const_cast<C*>(&object), const_method_stub<C, method_ptr> };
-  }
+    if (M)
+    {
+      if (auto const m = static_store::local())
+      {
+        if (!m->size_)
+        {
+          static_store::refill(*m);
+        }
+        // else do nothing
+
+        if (m->size_)
+        {
+          auto const p(m->slots_[--m->size_]);
+
+          try
+          {
+            return new (p) T(::std::forward<A>(args)...);
+          }
+          catch (...)
+          {
+            m->slots_[m->size_++] = p;
+
+            throw;
+          }
+        }
+        // else do nothing
+      }
+      // else do nothing
+    }
+    // else do nothing
 
-  template <typename T>
-  static staticdelegate from(T&& f)
-  {
-    return ::std::forward<T>(f);
+    return static_store::pool_.create(::std::forward<A>(args)...);
   }
 
-  static staticdelegate from(R (* const function_ptr)(A...))
+  template <typename T, ::std::size_t N = 16, ::std::size_t G = 0,
+    ::std::size_t M = 0>
+  inline void static_delete(T* const p)
   {
-    return function_ptr;
-  }
+    using static_store = static_store<T, N, G, M>;
 
-  template <class C>
-  using member_pair =
-    ::std::pair<C* const, R (C::* const)(A...)>;
+    if (M && static_store::pool_.owns(p))
+    {
+      if (auto const m = static_store::local())
+      {
+        p->~T();
 
-  template <class C>
-  using const_member_pair =
-    ::std::pair<C const* const, R (C::* const)(A...) const>;
+        if (M == m->size_)
+        {
+          static_store::flush(*m, (M + 1) / 2);
+        }
+        // else do nothing
 
-  template <class C>
-  static staticdelegate from(C* const object_ptr,
-    R (C::* const method_ptr)(A...))
-  {
-    return member_pair<C>(object_ptr, method_ptr);
-  }
+        m->slots_[m->size_++] = p;
 
-  template <class C>
-  static staticdelegate from(C const* const object_ptr,
-    R (C::* const method_ptr)(A...) const)
-  {
-    return const_member_pair<C>(object_ptr, method_ptr);
-  }
-
-  template <class C>
-  static staticdelegate from(C& object, R (C::* const method_ptr)(A...))
-  {
-    return member_pair<C>(&object, method_ptr);
-  }
+        return;
+      }
+      // else do nothing
+    }
+    // else do nothing
 
-  template <class C>
-  static staticdelegate from(C const& object,
-    R (C::* const method_ptr)(A...) const)
-  {
-    return const_member_pair<C>(&object, method_ptr);
+    static_store::pool_.destroy(p);
   }
+}
 
-  void reset() { stub_ptr_ = nullptr; store_.reset(); }
+namespace generic
+{
 
-  void reset_stub() noexcept { stub_ptr_ = nullptr; }
+template <::std::size_t N = 16, ::std::size_t G = 0, ::std::size_t M = 0>
+class pool_store
+{
+public:
+  pool_store() = default;
 
-  void swap(staticdelegate& other) noexcept { ::std::swap(*this, other); }
+  pool_store(pool_store const&) = default;
 
-  bool operator==(staticdelegate const& rhs) const noexcept
-  {
-    return (object_ptr_ == rhs.object_ptr_) && (stub_ptr_ == rhs.stub_ptr_);
-  }
+  pool_store(pool_store&&) = default;
 
-  bool operator!=(staticdelegate const& rhs) const noexcept
-  {
-    return !operator==(rhs);
-  }
+  pool_store& operator=(pool_store const&) = default;
 
-  bool operator<(staticdelegate const& rhs) const noexcept
-  {
-    return (object_ptr_ < rhs.object_ptr_) ||
-      ((object_ptr_ == rhs.object_ptr_) && (stub_ptr_ < rhs.stub_ptr_));
-  }
+  pool_store& operator=(pool_store&&) = default;
 
-  bool operator==(::std::nullptr_t const) const noexcept
+  template <typename T, typename F>
+  void emplace(F&& f)
   {
-    return !stub_ptr_;
-  }
+    store_.reset(static_new<T, N, G, M>(::std::forward<F>(f)),
+      functor_deleter<T>);
 
-  bool operator!=(::std::nullptr_t const) const noexcept
-  {
-    return stub_ptr_;
+    object_ = store_.get();
   }
 
-  explicit operator bool() const noexcept { return stub_ptr_; }
+  void* object() const noexcept { return object_; }
 
-  R operator()(A... args) const
-  {
-//  assert(stub_ptr);
-    return stub_ptr_(object_ptr_, ::std::forward<A>(args)...);
-  }
+  void reset(void* const o = nullptr) { store_.reset(); object_ = o; }
 
 private:
-  friend struct ::std::hash<staticdelegate>;
-
-  void* object_ptr_;
-  stub_ptr_type stub_ptr_{};
+  void* object_{};
 
   light_ptr<void> store_;
 
   template <class T>
   static void functor_deleter(void* const p)
   {
-    static_delete(static_cast<T*>(p));
-  }
-
-  template <R (*function_ptr)(A...)>
-  static R function_stub(void* const, A&&... args)
-  {
-    return function_ptr(::std::forward<A>(args)...);
-  }
-
-  template <class C, R (C::*method_ptr)(A...)>
-  static R method_stub(void* const object_ptr, A&&... args)
-  {
-    return (static_cast<C*>(object_ptr)->*method_ptr)(
-      ::std::forward<A>(args)...);
-  }
-
-  template <class C, R (C::*method_ptr)(A...) const>
-  static R const_method_stub(void* const object_ptr, A&&... args)
-  {
-    return (static_cast<C const*>(object_ptr)->*method_ptr)(
-      ::std::forward<A>(args)...);
-  }
-
-  template <typename>
-  struct is_member_pair : std::false_type { };
-
-  template <class C>
-  struct is_member_pair< ::std::pair<C* const,
-    R (C::* const)(A...)> > : std::true_type
-  {
-  };
-
-  template <typename>
-  struct is_const_member_pair : std::false_type { };
-
-  template <class C>
-  struct is_const_member_pair< ::std::pair<C const* const,
-    R (C::* const)(A...) const> > : std::true_type
-  {
-  };
-
-  template <typename T>
-  static typename ::std::enable_if<
-    !(is_member_pair<T>{} ||
-    is_const_member_pair<T>{}),
-    R
-  >::type
-  functor_stub(void* const object_ptr, A&&... args)
-  {
-    return (*static_cast<T*>(object_ptr))(::std::forward<A>(args)...);
-  }
-
-  template <typename T>
-  static typename ::std::enable_if<
-    is_member_pair<T>{} ||
-    is_const_member_pair<T>{},
-    R
-  >::type
-  functor_stub(void* const object_ptr, A&&... args)
-  {
-    return (static_cast<T*>(object_ptr)->first->*
-      static_cast<T*>(object_ptr)->second)(::std::forward<A>(args)...);
+    static_delete<T, N, G, M>(static_cast<T*>(p));
   }
 };
 
-}
+template <typename T, ::std::size_t N = 16, ::std::size_t G = 0,
+  ::std::size_t M = 0>
+using staticdelegate = basic_delegate<T, pool_store<N, G, M> >;
 
-namespace std
-{
-  template <typename R, typename ...A>
-  struct hash<::generic::staticdelegate<R (A...)> >
-  {
-    size_t operator()(
-      ::generic::staticdelegate<R (A...)> const& d) const noexcept
-    {
-      auto const seed(hash<void*>()(d.object_ptr_));
-
-      return hash<decltype(d.stub_ptr_)>()(d.stub_ptr_) +
-        0x9e3779b9 + (seed << 6) + (seed >> 2);
-    }
-  };
 }
 
 #endif // STATICDELEGATE_HPP